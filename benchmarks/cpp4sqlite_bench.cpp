@@ -0,0 +1,623 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+// Wrapper hot paths, each next to the equivalent raw sqlite3 loop (suffix _Raw).
+// Time is ns per iteration; allocs/op counts global operator new calls per iteration.
+// Scans read kRows rows per iteration and also report items_per_second (rows).
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <benchmark/benchmark.h>
+#include <cpp4sqlite.h>
+
+#include "cpp4sqlite_temp_db.h"
+
+using namespace cpp4sqlite;
+
+namespace
+{
+std::atomic<std::size_t> allocations {0};
+}
+
+void* operator new(std::size_t const size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* const ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* const ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* const ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+constexpr int kRows {1000};
+constexpr std::size_t kBlobSize {64 * 1024};
+
+// same data for both sides: t(i, r, s) of kRows rows; blobs(id, b) with one kBlobSize row
+constexpr char const* kSchema {R"(
+    CREATE TABLE t(i INTEGER, r REAL, s TEXT);
+    WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n WHERE x < 1000)
+    INSERT INTO t SELECT x, x * 0.5, printf('row %08d', x) FROM n;
+    CREATE TABLE blobs(id INTEGER PRIMARY KEY, b BLOB);
+    INSERT INTO blobs VALUES (1, zeroblob(65536));
+)"};
+
+constexpr char const* kPointQuery {"SELECT i, r, s FROM t WHERE rowid = ?"};
+constexpr char const* kScanQuery {"SELECT i, r, s FROM t"};
+
+/**
+ * Counts allocations over the timed loop and reports them per iteration
+ */
+class AllocationCounter
+{
+    benchmark::State& state;
+    std::size_t start {allocations.load(std::memory_order_relaxed)};
+
+public:
+    explicit AllocationCounter(benchmark::State& state)
+        : state {state}
+    {}
+
+    ~AllocationCounter()
+    {
+        auto const count = allocations.load(std::memory_order_relaxed) - start;
+        state.counters["allocs/op"] =
+            benchmark::Counter(static_cast<double>(count), benchmark::Counter::kAvgIterations);
+    }
+};
+
+struct Database
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+
+    Database()
+    {
+        conn.quickQuery(kSchema);
+    }
+};
+
+Connection& connection()
+{
+    static Database database {};
+    return database.conn;
+}
+
+sqlite3* rawDb()
+{
+    static sqlite3* const db = [] {
+        sqlite3* db {};
+        sqlite3_open_v2(":memory:", &db, SQLITE_OPEN_READWRITE, nullptr);
+        sqlite3_exec(db, kSchema, nullptr, nullptr, nullptr);
+        return db;
+    }();
+    return db;
+}
+
+sqlite3_stmt* rawPrepare(char const* queryStr)
+{
+    sqlite3_stmt* stmnt {};
+    sqlite3_prepare_v3(rawDb(), queryStr, -1, SQLITE_PREPARE_PERSISTENT, &stmnt, nullptr);
+    return stmnt;
+}
+
+std::string rawText(sqlite3_stmt* stmnt, int const posn)
+{
+    auto const text = reinterpret_cast<char const*>(sqlite3_column_text(stmnt, posn));
+    return {fixNullStr(text), static_cast<std::size_t>(sqlite3_column_bytes(stmnt, posn))};
+}
+
+std::vector<std::byte> const& blobData()
+{
+    static std::vector<std::byte> const data(kBlobSize, std::byte {0x5a});
+    return data;
+}
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Binder::setParams
+
+void BM_SetParams(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare("SELECT ?, ?, ?");
+    Binder binder {stmnt};
+    std::string const text {"some text"};
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        binder.setParams(42, 2.5, text);
+    }
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_SetParams);
+
+void BM_SetParams_Raw(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare("SELECT ?, ?, ?");
+    std::string const text {"some text"};
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        sqlite3_reset(stmnt);
+        sqlite3_bind_int(stmnt, 1, 42);
+        sqlite3_bind_double(stmnt, 2, 2.5);
+        sqlite3_bind_text(stmnt, 3, text.data(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+    }
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_SetParams_Raw);
+
+//--------------------------------------------------------------------------------------------------
+// prepare
+
+void BM_Prepare(benchmark::State& state)
+{
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        auto statement = connection().prepare(kPointQuery);
+        benchmark::DoNotOptimize(statement);
+    }
+}
+BENCHMARK(BM_Prepare);
+
+void BM_PrepareCached(benchmark::State& state)
+{
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        auto statement = connection().prepareCached(kPointQuery);
+        benchmark::DoNotOptimize(statement);
+    }
+}
+BENCHMARK(BM_PrepareCached);
+
+void BM_Prepare_Raw(benchmark::State& state)
+{
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        sqlite3_stmt* stmnt {};
+        sqlite3_prepare_v3(rawDb(), kPointQuery, -1, 0, &stmnt, nullptr);
+        benchmark::DoNotOptimize(stmnt);
+        sqlite3_finalize(stmnt);
+    }
+}
+BENCHMARK(BM_Prepare_Raw);
+
+//--------------------------------------------------------------------------------------------------
+// point query: bind, step, read one field
+
+void BM_FieldT(benchmark::State& state)
+{
+    auto statement = connection().prepare(kPointQuery);
+    AllocationCounter counter {state};
+    int id {0};
+    for (auto _ : state) {
+        auto resultset = statement.execute(id++ % kRows + 1);
+        benchmark::DoNotOptimize(resultset.fieldT<double>(1));
+    }
+}
+BENCHMARK(BM_FieldT);
+
+void BM_FieldT_Raw(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare(kPointQuery);
+    AllocationCounter counter {state};
+    int id {0};
+    for (auto _ : state) {
+        sqlite3_reset(stmnt);
+        sqlite3_bind_int(stmnt, 1, id++ % kRows + 1);
+        sqlite3_step(stmnt);
+        benchmark::DoNotOptimize(sqlite3_column_double(stmnt, 1));
+    }
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_FieldT_Raw);
+
+void BM_FieldS(benchmark::State& state)
+{
+    auto statement = connection().prepare(kPointQuery);
+    AllocationCounter counter {state};
+    int id {0};
+    for (auto _ : state) {
+        auto resultset = statement.execute(id++ % kRows + 1);
+        benchmark::DoNotOptimize(resultset.fieldS(2));
+    }
+}
+BENCHMARK(BM_FieldS);
+
+void BM_FieldS_Raw(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare(kPointQuery);
+    AllocationCounter counter {state};
+    int id {0};
+    for (auto _ : state) {
+        sqlite3_reset(stmnt);
+        sqlite3_bind_int(stmnt, 1, id++ % kRows + 1);
+        sqlite3_step(stmnt);
+        benchmark::DoNotOptimize(rawText(stmnt, 2));
+    }
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_FieldS_Raw);
+
+//--------------------------------------------------------------------------------------------------
+// scans of kRows rows: Resultset::step via the row accessors
+
+void BM_Step(benchmark::State& state)
+{
+    auto statement = connection().prepare(kScanQuery);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        for (auto const& row : statement.execute()) {
+            benchmark::DoNotOptimize(row.statement());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+BENCHMARK(BM_Step);
+
+void BM_Step_Raw(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare(kScanQuery);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        sqlite3_reset(stmnt);
+        while (sqlite3_step(stmnt) == SQLITE_ROW) {
+            benchmark::DoNotOptimize(stmnt);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_Step_Raw);
+
+void BM_Row(benchmark::State& state)
+{
+    auto statement = connection().prepare(kScanQuery);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        auto resultset = statement.execute();
+        while (auto const row = resultset.row()) {
+            benchmark::DoNotOptimize(row->data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+BENCHMARK(BM_Row);
+
+void BM_Row_Raw(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare(kScanQuery);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        sqlite3_reset(stmnt);
+        while (sqlite3_step(stmnt) == SQLITE_ROW) {
+            std::vector<std::pair<std::string, std::string>> row {};
+            row.reserve(3);
+            for (int i = 0; i < 3; ++i) {
+                row.emplace_back(sqlite3_column_name(stmnt, i), rawText(stmnt, i));
+            }
+            benchmark::DoNotOptimize(row.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_Row_Raw);
+
+void BM_RowS(benchmark::State& state)
+{
+    auto statement = connection().prepare(kScanQuery);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        auto resultset = statement.execute();
+        while (auto const row = resultset.rowS()) {
+            benchmark::DoNotOptimize(row->data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+BENCHMARK(BM_RowS);
+
+void BM_RowS_Raw(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare(kScanQuery);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        sqlite3_reset(stmnt);
+        while (sqlite3_step(stmnt) == SQLITE_ROW) {
+            std::vector<std::string> row {};
+            row.reserve(3);
+            for (int i = 0; i < 3; ++i) {
+                row.push_back(rawText(stmnt, i));
+            }
+            benchmark::DoNotOptimize(row.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_RowS_Raw);
+
+void BM_RowT(benchmark::State& state)
+{
+    auto statement = connection().prepare(kScanQuery);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        auto resultset = statement.execute();
+        while (auto const row = resultset.rowT<int, double, std::string>()) {
+            benchmark::DoNotOptimize(&*row);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+BENCHMARK(BM_RowT);
+
+void BM_RowT_Raw(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare(kScanQuery);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        sqlite3_reset(stmnt);
+        while (sqlite3_step(stmnt) == SQLITE_ROW) {
+            std::tuple<int, double, std::string> row {sqlite3_column_int(stmnt, 0),
+                                                      sqlite3_column_double(stmnt, 1),
+                                                      rawText(stmnt, 2)};
+            benchmark::DoNotOptimize(&row);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_RowT_Raw);
+
+//--------------------------------------------------------------------------------------------------
+// quickQuery
+
+void BM_QuickQuery(benchmark::State& state)
+{
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(connection().quickQuery(kScanQuery));
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+BENCHMARK(BM_QuickQuery);
+
+void BM_QuickQuery_Raw(benchmark::State& state)
+{
+    auto callback = [](void* table, int count, char** values, char** names) {
+        auto& rows = *static_cast<SqlTable*>(table);
+        SqlRow& row = rows.emplace_back();
+        for (int i = 0; i < count; ++i) {
+            row.emplace_back(names[i], fixNullStr(values[i]));
+        }
+        return 0;
+    };
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        SqlTable table {};
+        sqlite3_exec(rawDb(), kScanQuery, callback, &table, nullptr);
+        benchmark::DoNotOptimize(table.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kRows);
+}
+BENCHMARK(BM_QuickQuery_Raw);
+
+//--------------------------------------------------------------------------------------------------
+// blob in/out: bound / column values, and incremental blob i/o
+
+void BM_BlobBind(benchmark::State& state)
+{
+    auto statement = connection().prepare("UPDATE blobs SET b = ? WHERE id = 1");
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        statement.execute(BorrowedBlob {blobData()});
+    }
+    state.SetBytesProcessed(state.iterations() * kBlobSize);
+}
+BENCHMARK(BM_BlobBind);
+
+void BM_BlobBind_Raw(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare("UPDATE blobs SET b = ? WHERE id = 1");
+    auto const& data = blobData();
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        sqlite3_reset(stmnt);
+        sqlite3_bind_blob(stmnt, 1, data.data(), static_cast<int>(data.size()), SQLITE_STATIC);
+        sqlite3_step(stmnt);
+    }
+    state.SetBytesProcessed(state.iterations() * kBlobSize);
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_BlobBind_Raw);
+
+void BM_BlobColumn(benchmark::State& state)
+{
+    auto statement = connection().prepare("SELECT b FROM blobs WHERE id = 1");
+    std::vector<std::byte> out {};
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        auto resultset = statement.execute();
+        auto const blob = resultset.rowView()->operator[](0).blob();
+        out.assign(blob.begin(), blob.end());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * kBlobSize);
+}
+BENCHMARK(BM_BlobColumn);
+
+void BM_BlobColumn_Raw(benchmark::State& state)
+{
+    sqlite3_stmt* stmnt = rawPrepare("SELECT b FROM blobs WHERE id = 1");
+    std::vector<std::byte> out {};
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        sqlite3_reset(stmnt);
+        sqlite3_step(stmnt);
+        auto const data = static_cast<std::byte const*>(sqlite3_column_blob(stmnt, 0));
+        out.assign(data, data + sqlite3_column_bytes(stmnt, 0));
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * kBlobSize);
+    sqlite3_finalize(stmnt);
+}
+BENCHMARK(BM_BlobColumn_Raw);
+
+void BM_BlobStream(benchmark::State& state)
+{
+    auto const& data = blobData();
+    std::vector<std::byte> out(kBlobSize);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        auto blob = connection().openBlob("blobs", "b", 1, Connection::BlobAccess::write);
+        blob.write(data.data(), data.size(), 0);
+        blob.read(out.data(), out.size(), 0);
+    }
+    state.SetBytesProcessed(state.iterations() * kBlobSize * 2);
+}
+BENCHMARK(BM_BlobStream);
+
+void BM_BlobStream_Raw(benchmark::State& state)
+{
+    auto const& data = blobData();
+    std::vector<std::byte> out(kBlobSize);
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        sqlite3_blob* blob {};
+        sqlite3_blob_open(rawDb(), "main", "blobs", "b", 1, 1, &blob);
+        sqlite3_blob_write(blob, data.data(), static_cast<int>(data.size()), 0);
+        sqlite3_blob_read(blob, out.data(), static_cast<int>(out.size()), 0);
+        sqlite3_blob_close(blob);
+    }
+    state.SetBytesProcessed(state.iterations() * kBlobSize * 2);
+}
+BENCHMARK(BM_BlobStream_Raw);
+
+//--------------------------------------------------------------------------------------------------
+// ConnectionConfig presets on a file database: commits of kCommitRows rows, and point reads.
+// Arg 0 is sqlite's defaults; the label names the preset.
+
+namespace
+{
+constexpr int kCommitRows {100};
+
+std::pair<char const*, ConnectionConfig> preset(std::int64_t const index)
+{
+    switch (index) {
+        case 1:
+            return {"readHeavy", ConnectionConfig::readHeavy()};
+        case 2:
+            return {"bulkIngest", ConnectionConfig::bulkIngest()};
+        case 3:
+            return {"durable", ConnectionConfig::durable()};
+        default:
+            return {"default", ConnectionConfig {}};
+    }
+}
+
+/**
+ * Fresh database file with the preset of state.range(0), removed again on destruction
+ */
+struct FileDatabase
+{
+    TempDatabase const path {"cpp4sqlite_bench.db"};
+    std::unique_ptr<Connection> conn {};
+
+    explicit FileDatabase(benchmark::State& state)
+    {
+        auto [name, config] = preset(state.range(0));
+        state.SetLabel(name);
+        conn = std::make_unique<Connection>(path.string(), OpenOption::CREATERW, config);
+        conn->quickQuery(kSchema);
+    }
+};
+}  // namespace
+
+void BM_PresetCommit(benchmark::State& state)
+{
+    FileDatabase database {state};
+    Connection& conn = *database.conn;
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        auto transaction = conn.transaction();
+        auto insert = conn.prepareCached("INSERT INTO t VALUES (?, ?, ?)");
+        for (int i = 0; i < kCommitRows; ++i) {
+            insert.execute(i, 0.5, "inserted");
+        }
+        transaction.commit();
+    }
+    state.SetItemsProcessed(state.iterations() * kCommitRows);
+}
+BENCHMARK(BM_PresetCommit)->DenseRange(0, 3);
+
+void BM_PresetPointRead(benchmark::State& state)
+{
+    FileDatabase database {state};
+    auto statement = database.conn->prepare(kPointQuery);
+    int rowid {0};
+    AllocationCounter counter {state};
+    for (auto _ : state) {
+        rowid = rowid % kRows + 1;
+        benchmark::DoNotOptimize(statement.execute(rowid).fieldT<int>());
+    }
+}
+BENCHMARK(BM_PresetPointRead)->DenseRange(0, 3);
+
+//--------------------------------------------------------------------------------------------------
+// Writers contending for one WAL database, each thread with its own connection: a short
+// BEGIN IMMEDIATE transaction per iteration. Arg 0 waits with sqlite3_busy_timeout, arg 1 with a
+// BusyPolicy (exponential backoff with jitter).
+
+void BM_ContendedCommit(benchmark::State& state)
+{
+    static TempDatabase const path {"cpp4sqlite_bench_contended.db"};
+    if (state.thread_index() == 0) {
+        path.removeFiles();
+        Connection {path.string(), OpenOption::CREATERW}.quickQuery(
+            "PRAGMA journal_mode = WAL; CREATE TABLE t(a)");
+    }
+
+    ConnectionConfig config {};
+    config.synchronous = Synchronous::normal;
+    if (state.range(0) == 0) {
+        state.SetLabel("busy_timeout");
+        config.busyTimeout = std::chrono::seconds {10};
+    }
+    else {
+        state.SetLabel("BusyPolicy");
+        BusyPolicy policy {};
+        policy.initialDelay = std::chrono::microseconds {20};
+        policy.maxDelay = std::chrono::milliseconds {2};
+        policy.timeout = std::chrono::seconds {10};
+        config.busyPolicy = policy;
+    }
+    // benchmark starts the threads together, after thread 0 created the database
+    std::optional<Connection> conn {};
+    for (auto _ : state) {
+        if (!conn) {
+            state.PauseTiming();
+            conn.emplace(path.string(), OpenOption::READWRITE, config);
+            state.ResumeTiming();
+        }
+        auto transaction = conn->transaction(TransactionMode::immediate);
+        (void)conn->prepareCached("INSERT INTO t VALUES (?)").execute(state.thread_index());
+        transaction.commit();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ContendedCommit)->DenseRange(0, 1)->Threads(4)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -7,10 +7,25 @@
 #ifndef SQLITE_CPP_H
 #define SQLITE_CPP_H
 
+#include <cstddef>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <list>
+#include <memory>
 #include <optional>
 #include <sqlite3.h>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <variant>
 #include <vector>
 
 namespace cpp4sqlite
@@ -26,6 +41,19 @@ using SqlRow = std::vector<SqlField>;
 using SqlRowS = std::vector<std::string>;
 using SqlTable = std::vector<SqlRow>;
 
+using SqlBlob = std::vector<std::byte>;
+using SqlValue = std::variant<std::nullptr_t, sqlite3_int64, double, std::string, SqlBlob>;
+using SqlValueRow = std::vector<SqlValue>;
+
+/**
+ * Result of one statement of Connection::executeScript. Column names appear once, not per field
+ */
+struct QueryResult
+{
+    SqlColNames columns {};
+    std::vector<SqlValueRow> rows {};
+};
+
 //--------------------------------------------------------------------------------------------------
 
 enum class OpenOption
@@ -44,6 +72,11 @@ enum class OpenOption
     EXRESCODE    = 0x02000000
 };  // clang-format on
 
+inline OpenOption operator|(OpenOption const lhs, OpenOption const rhs)
+{
+    return static_cast<OpenOption>(static_cast<int>(lhs) | static_cast<int>(rhs));
+}
+
 //--------------------------------------------------------------------------------------------------
 
 inline char const* fixNullStr(char const* str)
@@ -53,17 +86,324 @@ inline char const* fixNullStr(char const* str)
 
 //--------------------------------------------------------------------------------------------------
 
+/**
+ * Result column names of a statement and a name -> position map, built once per statement and
+ * shared by each Resultset it produces. Rebuilt if sqlite re-prepares the statement.
+ */
+class ColumnIndex
+{
+    std::vector<SqlColName> names {};
+    std::unordered_map<std::string_view, int> positions {};  // views into names
+    int prepareCount {-1};
+    void const* memberPositionsOf {};  // tag of the row type memberPositions were resolved for
+    std::vector<int> memberPositions {};
+
+public:
+    void refresh(sqlite3_stmt* stmnt);
+
+    [[nodiscard]] SqlColName const& name(int posn) const;
+    [[nodiscard]] std::optional<int> posn(std::string_view name) const;
+
+    /**
+     * Column positions of a row type's members, from resolve() on first use by that type.
+     * Kept for the latest type only, until the statement is re-prepared.
+     */
+    template<typename Resolve>
+    std::vector<int> const& rowPositions(void const* rowTag, Resolve const& resolve)
+    {
+        if (rowTag != memberPositionsOf) {
+            auto const resolved = resolve();
+            memberPositions.assign(resolved.begin(), resolved.end());
+            memberPositionsOf = rowTag;
+        }
+        return memberPositions;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+class Backup;
+class BlobStream;
+class BusyHandler;
+class CheckpointScheduler;
 class PreparedStatement;
+class Profiler;
+class Savepoint;
+class Transaction;
+
+enum class TransactionMode
+{
+    deferred,
+    immediate,
+    exclusive
+};
+
+enum class JournalMode
+{
+    delete_,
+    truncate,
+    persist,
+    memory,
+    wal,
+    off
+};
+
+enum class Synchronous
+{
+    off,
+    normal,
+    full,
+    extra
+};
+
+enum class TempStore
+{
+    default_,
+    file,
+    memory
+};
+
+/**
+ * Waiting out SQLITE_BUSY: the n-th wait of a busy episode sleeps
+ * min(maxDelay, initialDelay * multiplier^n), scaled down by up to jitter (0..1) at random so
+ * contending writers spread out. Gives up once timeout would be passed.
+ * stepRetries: statements failing SQLITE_BUSY / SQLITE_LOCKED where the busy handler does not
+ * apply are rerun, after a backoff, up to this many times when that is safe: outside an explicit
+ * transaction (so including BEGIN), or COMMIT, and before any row was returned. This covers
+ * Resultset, quickQuery, executeScript, configure and executeMany, including its COMMIT.
+ */
+struct BusyPolicy
+{
+    std::chrono::microseconds initialDelay {100};
+    std::chrono::microseconds maxDelay {50000};
+    double multiplier {2.0};
+    double jitter {0.5};
+    std::chrono::milliseconds timeout {5000};
+    int stepRetries {3};
+};
+
+struct BusyStats
+{
+    std::uint64_t waits {};     // sleeps by the busy handler
+    std::uint64_t retries {};   // statements rerun after SQLITE_BUSY / SQLITE_LOCKED
+    std::uint64_t timeouts {};  // gave up, SQLITE_BUSY returned
+    std::chrono::nanoseconds blocked {};
+};
+
+/**
+ * Connection settings applied at open time. Unset members keep sqlite's defaults.
+ * Pragmas run as prepared statements; the rest through sqlite3_db_config, sqlite3_busy_timeout
+ * and sqlite3_wal_autocheckpoint.
+ */
+struct ConnectionConfig
+{
+    struct Lookaside
+    {
+        int slotSize {};
+        int slotCount {};
+    };
+
+    std::optional<JournalMode> journalMode {};
+    std::optional<Synchronous> synchronous {};
+    std::optional<int> cacheSize {};  // as PRAGMA cache_size: pages, or KiB if negative
+    std::optional<sqlite3_int64> mmapSize {};
+    std::optional<int> pageSize {};  // new databases only, or until the next VACUUM
+    std::optional<TempStore> tempStore {};
+    std::optional<std::chrono::milliseconds> busyTimeout {};
+    std::optional<Lookaside> lookaside {};
+    std::optional<int> walAutocheckpoint {};  // pages; 0 disables
+    std::optional<bool> foreignKeys {};
+    std::optional<BusyPolicy> busyPolicy {};  // replaces busyTimeout
+
+    /**
+     * WAL, synchronous NORMAL, 64MiB cache, 256MiB mmap, temp tables in memory, 5s busy timeout
+     */
+    static ConnectionConfig readHeavy();
+
+    /**
+     * WAL, synchronous OFF, 256MiB cache, infrequent checkpoints, foreign keys off.
+     * A power loss can corrupt: for loads that can be rerun
+     */
+    static ConnectionConfig bulkIngest();
+
+    /**
+     * WAL, synchronous FULL, foreign keys on, 5s busy timeout: each commit survives power loss
+     */
+    static ConnectionConfig durable();
+};
+
+/**
+ * sqlite3_stmt_status counters of one statement, since it was prepared or last reset.
+ * filter counts are of bloom filter checks; memUsed is bytes, not a counter.
+ */
+struct StatementStats
+{
+    std::string sql {};
+    int fullscanSteps {};  // steps of full table scans: candidates for an index
+    int sorts {};
+    int autoIndexes {};  // rows inserted into automatic indexes: a permanent one may help
+    int vmSteps {};
+    int reprepares {};  // since prepared: not reset
+    int runs {};
+    int filterHits {};
+    int filterMisses {};
+    int memUsed {};
+
+    static StatementStats of(sqlite3_stmt* stmnt, bool reset = false);
+};
+
+struct StatusValue
+{
+    sqlite3_int64 current {};
+    sqlite3_int64 highwater {};
+};
+
+/**
+ * Process-wide sqlite3_status64 memory counters, in bytes unless noted.
+ * pageCache* count use of the SQLITE_CONFIG_PAGECACHE buffer; overflow is what spilled to malloc.
+ */
+struct ProcessStatus
+{
+    StatusValue memoryUsed {};
+    StatusValue mallocSize {};   // highwater: largest single request
+    StatusValue mallocCount {};  // allocations outstanding
+    StatusValue pageCacheUsed {};  // pages
+    StatusValue pageCacheOverflow {};
+    StatusValue pageCacheSize {};  // highwater: largest page request
+    StatusValue parserStack {};    // highwater: deepest parser stack, in frames
+
+    /**
+     * resetHighwater: highwater marks restart from the current values after being read
+     */
+    static ProcessStatus snapshot(bool resetHighwater = false);
+};
+
+/**
+ * sqlite3_db_status of one connection: memory in bytes, page cache activity in pages
+ */
+struct ConnectionStatus
+{
+    StatusValue lookasideUsed {};  // slots
+    int lookasideHit {};
+    int lookasideMissSize {};
+    int lookasideMissFull {};
+    int cacheUsed {};
+    int cacheUsedShared {};
+    int cacheHit {};
+    int cacheMiss {};
+    int cacheWrite {};
+    int cacheSpill {};
+    int schemaUsed {};
+    int stmtUsed {};
+};
+
+/**
+ * Approximate heap bytes held by a materialised result, for comparison with the above
+ */
+[[nodiscard]] std::size_t footprint(SqlTable const& table);
+
+/**
+ * Latency of one query shape: sql with literals replaced by ? and whitespace collapsed.
+ * Percentiles are upper bounds of log-linear buckets, so within 12.5% above the true value.
+ */
+struct QueryProfile
+{
+    std::string sql {};
+    std::uint64_t count {};
+    std::chrono::nanoseconds total {};
+    std::chrono::nanoseconds max {};
+    std::chrono::nanoseconds p50 {};
+    std::chrono::nanoseconds p99 {};
+    std::chrono::nanoseconds p999 {};
+    std::vector<std::pair<std::chrono::nanoseconds, std::uint64_t>> buckets {};  // bound, count
+};
+
+/**
+ * Bounded LRU cache of prepared statements keyed by sql text. Owned by a Connection.
+ * A statement is leased out by acquire() and handed back by release(), which resets it and
+ * clears its bindings. Statements prepared here use SQLITE_PREPARE_PERSISTENT.
+ */
+class StatementCache
+{
+public:
+    struct Stats
+    {
+        std::size_t hits {};
+        std::size_t misses {};
+        std::size_t evictions {};
+        std::size_t size {};
+    };
+
+    struct Lease
+    {
+        sqlite3_stmt* stmnt {};
+        ColumnIndex* columnIndex {};
+    };
+
+    explicit StatementCache(std::size_t capacity);
+    ~StatementCache();
+    StatementCache(StatementCache&) = delete;
+    StatementCache& operator=(StatementCache&) = delete;
+
+    /**
+     * Leased statement, or a null stmnt if the sql is already leased or the cache is full of
+     * leased statements. In that case the caller prepares an uncached statement.
+     */
+    [[nodiscard]] Lease acquire(sqlite3* db, std::string const& queryStr);
+    void release(sqlite3_stmt* stmnt);
+
+    void setCapacity(std::size_t capacity);
+    [[nodiscard]] std::size_t capacity() const;
+    [[nodiscard]] Stats stats() const;
+    void resetStats();
+
+    /**
+     * Finalize all statements not currently leased
+     */
+    void clear();
+
+private:
+    struct Entry
+    {
+        std::string queryStr {};
+        sqlite3_stmt* stmnt {};
+        bool leased {false};
+        std::unique_ptr<ColumnIndex> columnIndex {std::make_unique<ColumnIndex>()};
+    };
+
+    using Lru = std::list<Entry>;  // most recently used at front
+
+    std::size_t maxSize {};
+    Lru lru {};
+    std::unordered_map<std::string_view, Lru::iterator> bySql {};
+    std::unordered_map<sqlite3_stmt*, Lru::iterator> byStmnt {};
+    Stats counters {};
+
+    void erase(Lru::iterator entry);
+    void evictToCapacity(std::size_t limit);
+};
+
+//--------------------------------------------------------------------------------------------------
 
 class Connection
 {
     sqlite3* sqliteDb {};
     std::string errorMsg {};
-    SqlTable results {};
+    StatementCache statementCache {defaultStatementCacheCapacity};
+    std::unique_ptr<Profiler> profiler {};
+    std::unique_ptr<BusyHandler> busyHandler {};
 
 public:
     explicit
     Connection(std::string_view name, OpenOption = OpenOption::READONLY, char const* vfs = nullptr);
+
+    /**
+     * Open, then configure(config)
+     */
+    Connection(std::string_view name,
+               OpenOption option,
+               ConnectionConfig const& config,
+               char const* vfs = nullptr);
     ~Connection();
     Connection() = delete;
     Connection(Connection&) = delete;
@@ -72,16 +412,78 @@ public:
     Connection& operator=(Connection&&) = delete;
 
     /**
-     * Quick Query
+     * Quick Query. Rows of all statements as colName/stringValue pairs, NULL as ""
      */
     SqlTable quickQuery(std::string const& queryStr);
-    int processSqlite3Callback(int count, char** values, char** names);
+
+    /**
+     * Run each statement of a multi-statement string in turn.
+     * One QueryResult, with typed values, per statement that returns columns.
+     */
+    std::vector<QueryResult> executeScript(std::string_view queryStr);
 
     /**
      * Prepared Statement
      */
     [[nodiscard]] PreparedStatement prepare(std::string const& queryStr, int prepFlags = 0) const;
 
+    /**
+     * Prepared Statement leased from the connection's statement cache.
+     * Returned to the cache (reset, bindings cleared) when the PreparedStatement is destroyed.
+     * Must not outlive the Connection.
+     */
+    [[nodiscard]] PreparedStatement prepareCached(std::string const& queryStr);
+
+    /**
+     * PreparedStatement::executeMany on a cached statement
+     */
+    template<typename Range>
+    std::size_t executeMany(std::string const& queryStr,
+                            Range&& rows,
+                            std::size_t commitInterval = 0);
+
+    template<typename Range,
+             typename Projection,
+             typename = std::enable_if_t<!std::is_integral_v<Projection>>>
+    std::size_t executeMany(std::string const& queryStr,
+                            Range&& rows,
+                            Projection project,
+                            std::size_t commitInterval = 0);
+
+    /**
+     * RAII transaction / savepoint, rolled back on destruction unless committed / released.
+     * BEGIN, COMMIT etc. run as cached statements
+     */
+    [[nodiscard]] Transaction transaction(TransactionMode mode = TransactionMode::deferred);
+    [[nodiscard]] Savepoint savepoint();
+
+    static constexpr std::size_t defaultStatementCacheCapacity {64};
+    void setStatementCacheCapacity(std::size_t capacity);
+    [[nodiscard]] StatementCache::Stats statementCacheStats() const;
+    void clearStatementCache();
+
+    /**
+     * Counters of every live statement of the connection, including idle cached ones
+     */
+    [[nodiscard]] std::vector<StatementStats> statementStats() const;
+    void resetStatementStats();
+
+    /**
+     * resetHighwater: lookaside and cache hit/miss/write/spill counters restart after being read
+     */
+    [[nodiscard]] ConnectionStatus status(bool resetHighwater = false) const;
+
+    /**
+     * Opt-in latency histograms per query shape, fed by sqlite3_trace_v2 SQLITE_TRACE_PROFILE.
+     * Recording takes no locks once a shape has been seen, so may be left on. profile() and
+     * resetProfile() may be called from another thread; a reset concurrent with recording can
+     * lose the samples in flight. disableProfiling() keeps what was recorded.
+     */
+    void enableProfiling();
+    void disableProfiling();
+    [[nodiscard]] std::vector<QueryProfile> profile() const;
+    void resetProfile();
+
     [[nodiscard]] std::string errorStr() const;
     [[nodiscard]] int affectedRows() const;
     [[nodiscard]] int lastInsertId() const;
@@ -94,20 +496,57 @@ public:
      */
     [[nodiscard]] bool getAutocommit() const;
 
+    /**
+     * Install a busy handler following policy, replacing any busy timeout or previous policy.
+     * Statistics restart.
+     */
+    void setBusyPolicy(BusyPolicy const& policy);
+    void clearBusyPolicy();
+    [[nodiscard]] BusyStats busyStats() const;  // zeros without a policy
+
+    /**
+     * Apply the settings present in config, lookaside and page_size first as they only take
+     * effect before the connection / database is used. Throws if the journal mode cannot be set
+     * (eg WAL on :memory:)
+     */
+    void configure(ConnectionConfig const& config);
+
+    enum class BlobAccess
+    {
+        read,
+        write
+    };
+
+    /**
+     * Incremental blob i/o on an existing row. To stream a large value in, insert a ZeroBlob of
+     * the final size then write it via the returned BlobStream.
+     */
+    [[nodiscard]] BlobStream openBlob(std::string const& table,
+                                      std::string const& column,
+                                      sqlite3_int64 rowid,
+                                      BlobAccess access = BlobAccess::read,
+                                      std::string const& dbName = "main") const;
+
 private:
+    friend class Backup;
+    friend class CheckpointScheduler;
+    friend class Savepoint;
+    friend class Transaction;
+
+    int savepointDepth {0};
+
     void close() const;
+    void execCached(std::string const& queryStr);
+
+    template<typename OnStatement, typename OnRow>
+    void forEachStatement(std::string_view queryStr,
+                          char const* what,
+                          OnStatement onStatement,
+                          OnRow onRow);
 };
 
 //--------------------------------------------------------------------------------------------------
 
-/**
- * fires each time quickQuery generates a resultset row
- */
-inline int callback(void* host, int const numFields, char** values, char** names)
-{
-    return static_cast<Connection*>(host)->processSqlite3Callback(numFields, values, names);
-}
-
 inline std::string errString(int const errornum)
 {
     char const* errStr = sqlite3_errstr(errornum);
@@ -116,6 +555,71 @@ inline std::string errString(int const errornum)
 
 //--------------------------------------------------------------------------------------------------
 
+/**
+ * Borrowed bind types. Bound with SQLITE_STATIC so sqlite does not copy the buffer.
+ *
+ * Lifetime: the referenced buffer must stay valid and unchanged from execute() until the
+ * statement is next executed, or the PreparedStatement is destroyed (a cached statement is
+ * returned to its cache). In practice: outlive the Resultset and every step taken on it.
+ */
+struct BorrowedText
+{
+    std::string_view text {};
+
+    explicit BorrowedText(std::string_view text)
+        : text {text}
+    {}
+};
+
+struct BorrowedBlob
+{
+    void const* data {};
+    std::size_t size {};
+
+    BorrowedBlob(void const* data, std::size_t const size)
+        : data {data}
+        , size {size}
+    {}
+
+    /**
+     * Any contiguous container of byte sized elements, eg std::string, std::vector<std::byte>
+     */
+    template<typename Container,
+             typename = std::enable_if_t<sizeof(*std::data(std::declval<Container&>())) == 1>>
+    explicit BorrowedBlob(Container const& bytes)
+        : data {std::data(bytes)}
+        , size {std::size(bytes)}
+    {}
+};
+
+/**
+ * Binds a blob of `size` zero bytes (sqlite3_bind_zeroblob64) without allocating it.
+ * Fill it afterwards using Connection::openBlob()
+ */
+struct ZeroBlob
+{
+    sqlite3_uint64 size {};
+};
+
+//--------------------------------------------------------------------------------------------------
+
+template<typename>
+inline constexpr bool unsupportedType {false};
+
+template<typename T>
+inline constexpr bool isOptional {false};
+
+template<typename T>
+inline constexpr bool isOptional<std::optional<T>> {true};
+
+template<typename T, typename = void>
+inline constexpr bool isTupleLike {false};
+
+template<typename T>
+inline constexpr bool isTupleLike<T, std::void_t<decltype(std::tuple_size<T>::value)>> {true};
+
+//--------------------------------------------------------------------------------------------------
+
 class Resultset;
 
 class Binder
@@ -130,44 +634,57 @@ public:
      * Set parameters of prepared statement
      */
     template<typename... Types>
-    void setParams(Types... values)
+    void setParams(Types&&... values)
     {
         checkBindParamCount(sizeof...(Types));
+        rebind(std::forward<Types>(values)...);
+    }
+
+    /**
+     * As setParams, without the parameter count check. For repeat executions of a statement
+     * whose count has already been checked
+     */
+    template<typename... Types>
+    void rebind(Types&&... values)
+    {
         reset();
-        auto doBinds = [&](auto&&... arg) {
-            (bind(arg), ...);
-        };
-        std::apply(doBinds, std::tuple<Types...> {values...});
+        (bind(std::forward<Types>(values)), ...);
     }
 
 private:
     template<typename T>
-    void bind(T& param)
+    void bind(T const& param)
     {
         ++bindPosn;
+        bindValue<std::decay_t<T const>>(param);
+    }
+
+    template<typename T>
+    void bindValue(T const& param)
+    {
+        if constexpr (std::is_same_v<T, bool>) {
+            bindInt(param ? 1 : 0);
+        }
 
-        if constexpr (std::is_same_v<T, int>) {
+        else if constexpr (std::is_same_v<T, int>) {
             bindInt(param);
         }
 
-        else if constexpr (std::is_same_v<T, double>) {
+        else if constexpr (std::is_same_v<T, unsigned> || std::is_same_v<T, long>
+                           || std::is_same_v<T, long long>) {
+            bindInt64(static_cast<sqlite3_int64>(param));
+        }
+
+        else if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
             bindDouble(param);
         }
 
-        else if constexpr (std::is_same_v<T, char const*>) {
+        else if constexpr (std::is_same_v<T, char const*> || std::is_same_v<T, char*>) {
             bindText(param);
         }
 
-        else if constexpr (std::is_same_v<T, std::string>) {
-            auto const data = param.data();
-            if (strlen(param.data()) == param.size()) {
-                {
-                    bindText(data);
-                }
-            }
-            else {
-                bindBlob(param);
-            }
+        else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+            bindString(param);
         }
 
         else if constexpr (std::is_same_v<T, std::filesystem::path>) {
@@ -186,15 +703,45 @@ private:
             bindBlob(str);
         }
 
-        else if constexpr (std::is_same_v<T, std::nullptr_t>) {
-            checkResult(sqlite3_bind_null(stmnt, bindPosn));
+        else if constexpr (std::is_same_v<T, std::nullptr_t> || std::is_same_v<T, std::nullopt_t>) {
+            bindNull();
+        }
+
+        else if constexpr (isOptional<T>) {
+            if (param) {
+                bindValue<typename T::value_type>(*param);
+            }
+            else {
+                bindNull();
+            }
+        }
+
+        else if constexpr (std::is_same_v<T, BorrowedText>) {
+            bindTextStatic(param.text);
+        }
+
+        else if constexpr (std::is_same_v<T, BorrowedBlob>) {
+            bindBlobStatic(param.data, param.size);
+        }
+
+        else if constexpr (std::is_same_v<T, ZeroBlob>) {
+            checkResult(sqlite3_bind_zeroblob64(stmnt, bindPosn, param.size));
+        }
+
+        else {
+            static_assert(unsupportedType<T>, "Binder: unsupported bind type");
         }
     }
 
     void bindInt(int param) const;
+    void bindInt64(sqlite3_int64 param) const;
     void bindDouble(double param) const;
+    void bindNull() const;
     void bindText(char const* param) const;
-    void bindBlob(std::string const& param) const;
+    void bindString(std::string_view param) const;  // blob if it contains a null
+    void bindBlob(std::string_view param) const;
+    void bindTextStatic(std::string_view param) const;
+    void bindBlobStatic(void const* data, std::size_t size) const;
 
     void reset();
     void checkBindParamCount(std::size_t size) const;
@@ -208,11 +755,13 @@ class ResultColumn
     sqlite3_stmt* stmnt {};
     int posn {};
     int type {};  // 1 SQLITE_INTEGER, 2 SQLITE_FLOAT, 3 SQLITE_TEXT, 4 SQLITE_BLOB, 5 SQLITE_NULL
+    SqlColName const* colName {};  // owned by the statement's ColumnIndex
 
 public:
-    ResultColumn(sqlite3_stmt* stmnt, int posn);
+    ResultColumn(sqlite3_stmt* stmnt, int posn, SqlColName const& name);
 
-    [[nodiscard]] SqlColName name() const;
+    [[nodiscard]] SqlColName const& name() const;
+    void refreshType();  // on each new row
 
     [[nodiscard]] SqlField field() const;
     [[nodiscard]] std::string fieldS() const;
@@ -224,11 +773,15 @@ public:
             return {};
         }
 
-        if constexpr (std::is_same_v<T, int>) {
+        if constexpr (std::is_same_v<T, bool>) {
+            return sqlite3_column_int(stmnt, posn) != 0;
+        }
+        else if constexpr (std::is_same_v<T, int>) {
             return sqlite3_column_int(stmnt, posn);
         }
-        if constexpr (std::is_same_v<T, long long>) {
-            return sqlite3_column_int64(stmnt, posn);
+        else if constexpr (std::is_same_v<T, unsigned> || std::is_same_v<T, long>
+                           || std::is_same_v<T, long long>) {
+            return static_cast<T>(sqlite3_column_int64(stmnt, posn));
         }
         else if constexpr (std::is_same_v<T, double>) {
             return sqlite3_column_double(stmnt, posn);
@@ -248,37 +801,637 @@ private:
 
 //--------------------------------------------------------------------------------------------------
 
-class Resultset
+/**
+ * Non-owning views into sqlite's buffers for the current row. No copies or allocations.
+ * Valid until the Resultset moves to another row (or is reset / destroyed).
+ */
+struct BlobView
 {
-    sqlite3_stmt* stmnt {};
-    bool hasRow {false};
-    int columnPosn {0};
-    std::vector<ResultColumn> columns {};
+    std::byte const* data {};
+    std::size_t size {};
 
-public:
-    enum class FileReplace
+    [[nodiscard]] std::byte const* begin() const
     {
-        no,
-        yes
-    };
+        return data;
+    }
 
-    explicit Resultset(sqlite3_stmt* stmnt);
+    [[nodiscard]] std::byte const* end() const
+    {
+        return data + size;
+    }
 
-    [[nodiscard]] int countColumns() const;
-    [[nodiscard]] int countData() const;
-    [[nodiscard]] bool empty() const;
+    [[nodiscard]] bool empty() const
+    {
+        return size == 0;
+    }
+};
 
-    [[nodiscard]] SqlField
-    field(int posn = 0) const;  // field (name/value pair) at position (0-based)
-    [[nodiscard]] SqlField field(SqlColName const& name) const;  // named field
-    SqlField nextField();                                        // next field
+class FieldView
+{
+    sqlite3_stmt* stmnt {};
+    int posn {};
+    SqlColName const* colName {};
 
-    [[nodiscard]] std::string fieldS(int posn = 0) const;
-    [[nodiscard]] std::string fieldS(SqlColName const& name) const;
-    std::string nextFieldS();
+public:
+    FieldView(sqlite3_stmt* stmnt, int posn, SqlColName const& name);
 
-    std::optional<SqlRow> row();
-    std::optional<SqlRowS> rowS();
+    [[nodiscard]] std::string_view name() const;
+    [[nodiscard]] int type() const;  // SQLITE_INTEGER .. SQLITE_NULL, of the current row
+    [[nodiscard]] bool isNull() const;
+
+    [[nodiscard]] std::string_view text() const;  // empty if NULL
+    [[nodiscard]] BlobView blob() const;          // empty if NULL
+    [[nodiscard]] sqlite3_int64 int64() const;    // 0 if NULL
+    [[nodiscard]] double real() const;            // 0.0 if NULL
+};
+
+class RowView
+{
+    sqlite3_stmt* stmnt {};
+    ColumnIndex const* columnIndex {};
+
+public:
+    class Iterator
+    {
+        sqlite3_stmt* stmnt {};
+        ColumnIndex const* columnIndex {};
+        int posn {};
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = FieldView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = FieldView;
+
+        Iterator(RowView const& row, int posn);
+
+        FieldView operator*() const;
+        Iterator& operator++();
+        Iterator operator++(int);
+        bool operator==(Iterator const& other) const;
+        bool operator!=(Iterator const& other) const;
+    };
+
+    RowView(sqlite3_stmt* stmnt, ColumnIndex const& columnIndex);
+
+    [[nodiscard]] sqlite3_stmt* statement() const;
+    [[nodiscard]] int size() const;
+    [[nodiscard]] SqlValueRow values() const;  // copied out, as columnValue<SqlValue>
+    [[nodiscard]] FieldView operator[](int posn) const;
+    [[nodiscard]] FieldView operator[](std::string_view name) const;  // throws if not found
+
+    [[nodiscard]] Iterator begin() const;
+    [[nodiscard]] Iterator end() const;
+};
+
+/**
+ * Value of a column of the current row, converted by sqlite as for sqlite3_column_*().
+ * NULL gives a value-initialised T, or nullopt for std::optional<T>.
+ * SqlValue keeps the column's storage class.
+ * std::string_view and BlobView point into sqlite's buffers: valid until the next row.
+ */
+template<typename T>
+T columnValue(sqlite3_stmt* stmnt, int const posn)
+{
+    if constexpr (isOptional<T>) {
+        if (sqlite3_column_type(stmnt, posn) == SQLITE_NULL) {
+            return std::nullopt;
+        }
+        return columnValue<typename T::value_type>(stmnt, posn);
+    }
+
+    else if constexpr (std::is_same_v<T, bool>) {
+        return sqlite3_column_int64(stmnt, posn) != 0;
+    }
+
+    else if constexpr (std::is_same_v<T, int>) {
+        return sqlite3_column_int(stmnt, posn);
+    }
+
+    else if constexpr (std::is_same_v<T, unsigned> || std::is_same_v<T, long>
+                       || std::is_same_v<T, long long>) {
+        return static_cast<T>(sqlite3_column_int64(stmnt, posn));
+    }
+
+    else if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+        return static_cast<T>(sqlite3_column_double(stmnt, posn));
+    }
+
+    else if constexpr (std::is_same_v<T, std::string_view>) {
+        auto const text = reinterpret_cast<const char*>(sqlite3_column_text(stmnt, posn));
+        auto const size = static_cast<std::size_t>(sqlite3_column_bytes(stmnt, posn));
+        return {fixNullStr(text), size};
+    }
+
+    else if constexpr (std::is_same_v<T, std::string>) {
+        return std::string {columnValue<std::string_view>(stmnt, posn)};
+    }
+
+    else if constexpr (std::is_same_v<T, BlobView>) {
+        auto const data = static_cast<std::byte const*>(sqlite3_column_blob(stmnt, posn));
+        auto const size = static_cast<std::size_t>(sqlite3_column_bytes(stmnt, posn));
+        return {data, size};
+    }
+
+    else if constexpr (std::is_same_v<T, SqlValue>) {
+        switch (sqlite3_column_type(stmnt, posn)) {
+            case SQLITE_INTEGER:
+                return sqlite3_column_int64(stmnt, posn);
+            case SQLITE_FLOAT:
+                return sqlite3_column_double(stmnt, posn);
+            case SQLITE_TEXT:
+                return columnValue<std::string>(stmnt, posn);
+            case SQLITE_BLOB: {
+                auto const blob = columnValue<BlobView>(stmnt, posn);
+                return SqlBlob {blob.begin(), blob.end()};
+            }
+            default:
+                return nullptr;
+        }
+    }
+
+    else {
+        static_assert(unsupportedType<T>, "columnValue: unsupported column type");
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Aggregate reflection for rowAs: member count by brace-init probing, then structured bindings.
+ * Supports aggregates of up to 16 members with no base classes or nested aggregates.
+ */
+struct AnyMember
+{
+    template<typename T>
+    operator T&() const;
+};
+
+template<typename T, typename = void, typename... Members>
+inline constexpr bool bracesInitialise {false};
+
+template<typename T, typename... Members>
+inline constexpr bool bracesInitialise<T, std::void_t<decltype(T {Members {}...})>, Members...> {
+    true};
+
+template<typename T, typename... Members>
+constexpr std::size_t aggregateArity()
+{
+    if constexpr (sizeof...(Members) <= 16 && bracesInitialise<T, void, Members..., AnyMember>) {
+        return aggregateArity<T, Members..., AnyMember>();
+    }
+    else {
+        return sizeof...(Members);
+    }
+}
+
+template<typename T>
+auto tieAggregate(T& object)
+{
+    constexpr std::size_t arity = aggregateArity<T>();
+    static_assert(arity > 0 && arity <= 16, "tieAggregate: not a supported aggregate");
+
+    if constexpr (arity == 16) {
+        auto& [m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14, m15] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14, m15);
+    }
+    else if constexpr (arity == 15) {
+        auto& [m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14);
+    }
+    else if constexpr (arity == 14) {
+        auto& [m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13);
+    }
+    else if constexpr (arity == 13) {
+        auto& [m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12);
+    }
+    else if constexpr (arity == 12) {
+        auto& [m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11);
+    }
+    else if constexpr (arity == 11) {
+        auto& [m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10);
+    }
+    else if constexpr (arity == 10) {
+        auto& [m0, m1, m2, m3, m4, m5, m6, m7, m8, m9] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6, m7, m8, m9);
+    }
+    else if constexpr (arity == 9) {
+        auto& [m0, m1, m2, m3, m4, m5, m6, m7, m8] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6, m7, m8);
+    }
+    else if constexpr (arity == 8) {
+        auto& [m0, m1, m2, m3, m4, m5, m6, m7] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6, m7);
+    }
+    else if constexpr (arity == 7) {
+        auto& [m0, m1, m2, m3, m4, m5, m6] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5, m6);
+    }
+    else if constexpr (arity == 6) {
+        auto& [m0, m1, m2, m3, m4, m5] = object;
+        return std::tie(m0, m1, m2, m3, m4, m5);
+    }
+    else if constexpr (arity == 5) {
+        auto& [m0, m1, m2, m3, m4] = object;
+        return std::tie(m0, m1, m2, m3, m4);
+    }
+    else if constexpr (arity == 4) {
+        auto& [m0, m1, m2, m3] = object;
+        return std::tie(m0, m1, m2, m3);
+    }
+    else if constexpr (arity == 3) {
+        auto& [m0, m1, m2] = object;
+        return std::tie(m0, m1, m2);
+    }
+    else if constexpr (arity == 2) {
+        auto& [m0, m1] = object;
+        return std::tie(m0, m1);
+    }
+    else if constexpr (arity == 1) {
+        auto& [m0] = object;
+        return std::tie(m0);
+    }
+}
+
+/**
+ * Maps result columns to the members of T for Resultset::rowAs / rowsAs.
+ * Default: members of aggregate T in declaration order are result columns in order.
+ * Specialise to choose members, and optionally columns by name (resolved once per range):
+ *     template<> struct RowMapping<Person> {
+ *         static auto members(Person& p) { return std::tie(p.id, p.name); }
+ *         static constexpr std::array<std::string_view, 2> columns {"id", "name"};
+ *     };
+ */
+template<typename T>
+struct RowMapping
+{
+    static auto members(T& object)
+    {
+        return tieAggregate(object);
+    }
+};
+
+template<typename Mapping, typename = void>
+inline constexpr bool hasColumnNames {false};
+
+template<typename Mapping>
+inline constexpr bool hasColumnNames<Mapping, std::void_t<decltype(Mapping::columns)>> {true};
+
+template<typename T>
+using RowMembers = decltype(RowMapping<T>::members(std::declval<T&>()));
+
+template<typename T>
+inline constexpr std::size_t rowMemberCount {std::tuple_size_v<RowMembers<T>>};
+
+/**
+ * As columnValue, but reuses existing string capacity
+ */
+template<typename T>
+void assignColumn(T& member, sqlite3_stmt* stmnt, int const posn)
+{
+    if constexpr (std::is_same_v<T, std::string>) {
+        member.assign(columnValue<std::string_view>(stmnt, posn));
+    }
+    else {
+        member = columnValue<T>(stmnt, posn);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * One column of a ColumnBatch, Arrow style: contiguous values plus a validity bitmap
+ * (bit i of byte i / 8 set if row i is not NULL). NULLs hold 0, 0.0 or empty text.
+ * text: row i is arena[offsets[i], offsets[i + 1]). Blobs are held as text.
+ */
+struct ColumnBuffer
+{
+    enum class Kind
+    {
+        int64,
+        real,
+        text
+    };
+
+    Kind kind {Kind::text};
+    std::vector<std::int64_t> ints {};
+    std::vector<double> reals {};
+    std::vector<std::uint32_t> offsets {};
+    std::string arena {};
+    std::vector<std::uint8_t> validity {};
+
+    [[nodiscard]] bool valid(std::size_t const row) const
+    {
+        return (validity[row / 8] >> (row % 8)) & 1U;
+    }
+
+    [[nodiscard]] std::string_view text(std::size_t const row) const
+    {
+        return std::string_view {arena}.substr(offsets[row], offsets[row + 1] - offsets[row]);
+    }
+
+    void clear();
+};
+
+struct ColumnBatch
+{
+    std::size_t rows {};
+    std::vector<ColumnBuffer> columns {};
+};
+
+//--------------------------------------------------------------------------------------------------
+
+class Resultset
+{
+    sqlite3_stmt* stmnt {};
+    ColumnIndex* columnIndex {};
+    bool hasRow {false};
+    bool advancePending {false};  // set by rowView()
+    int columnPosn {0};
+    std::vector<ResultColumn> columns {};
+
+public:
+    enum class FileReplace
+    {
+        no,
+        yes
+    };
+
+    Resultset(sqlite3_stmt* stmnt, ColumnIndex& columnIndex);
+
+    [[nodiscard]] int countColumns() const;
+    [[nodiscard]] int countData() const;
+    [[nodiscard]] SqlColName const& columnName(int posn) const;
+    [[nodiscard]] SqlColNames columnNames() const;
+
+    /**
+     * Remaining rows, typed, with the column names
+     */
+    QueryResult fetchAll();
+    [[nodiscard]] bool empty() const;
+
+    [[nodiscard]] SqlField
+    field(int posn = 0) const;  // field (name/value pair) at position (0-based)
+    [[nodiscard]] SqlField field(std::string_view name) const;  // named field
+    SqlField nextField();                                       // next field
+
+    [[nodiscard]] std::string fieldS(int posn = 0) const;
+    [[nodiscard]] std::string fieldS(std::string_view name) const;
+    std::string nextFieldS();
+
+    std::optional<SqlRow> row();
+    std::optional<SqlRowS> rowS();
+
+    /**
+     * Current row as a zero-copy view. The Resultset advances on the next rowView(), row(),
+     * rowS() or rowT() call, which invalidates the view. Loop as for row():
+     *     while (auto const view = resultSet.rowView()) { ... }
+     */
+    std::optional<RowView> rowView();
+
+    /**
+     * Input range over the rows, stepping sqlite as it goes:
+     *     for (auto const& row : resultSet) { ... }
+     * Each RowView is valid until the iterator is incremented.
+     */
+    class Iterator
+    {
+        Resultset* resultset {};
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = RowView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = RowView;
+
+        explicit Iterator(Resultset* resultset = nullptr);
+
+        RowView operator*() const;
+        Iterator& operator++();
+        void operator++(int);
+        bool operator==(Iterator const& other) const;
+        bool operator!=(Iterator const& other) const;
+
+    private:
+        [[nodiscard]] bool atEnd() const;
+    };
+
+    Iterator begin();
+    Iterator end();
+
+    /**
+     * Input range of std::tuple<T...> per row, decoded as for columnValue():
+     *     for (auto const& [id, name] : resultSet.as<int, std::string>()) { ... }
+     */
+    template<typename... T>
+    class TypedRange
+    {
+        Resultset* resultset {};
+
+    public:
+        class Iterator
+        {
+            Resultset::Iterator rows {};
+
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = std::tuple<T...>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            Iterator() = default;
+
+            explicit Iterator(Resultset::Iterator rows)
+                : rows {rows}
+            {}
+
+            value_type operator*() const
+            {
+                return decode(std::index_sequence_for<T...> {});
+            }
+
+            Iterator& operator++()
+            {
+                ++rows;
+                return *this;
+            }
+
+            void operator++(int)
+            {
+                ++rows;
+            }
+
+            bool operator==(Iterator const& other) const
+            {
+                return rows == other.rows;
+            }
+
+            bool operator!=(Iterator const& other) const
+            {
+                return rows != other.rows;
+            }
+
+        private:
+            template<std::size_t... I>
+            value_type decode(std::index_sequence<I...>) const
+            {
+                sqlite3_stmt* stmnt = (*rows).statement();
+                return value_type {columnValue<T>(stmnt, static_cast<int>(I))...};
+            }
+        };
+
+        explicit TypedRange(Resultset* resultset)
+            : resultset {resultset}
+        {}
+
+        Iterator begin()
+        {
+            return Iterator {resultset->begin()};
+        }
+
+        Iterator end()
+        {
+            return Iterator {resultset->end()};
+        }
+    };
+
+    template<typename... T>
+    TypedRange<T...> as()
+    {
+        checkTypeCount(sizeof...(T), countColumns());
+        return TypedRange<T...> {this};
+    }
+
+    /**
+     * Decode the current row into the members of T (see RowMapping), then advance.
+     * The second form reuses out, including its string capacity; false if no row.
+     */
+    template<typename T>
+    std::optional<T> rowAs()
+    {
+        T out {};
+        if (!rowAs(out)) {
+            return {};
+        }
+        return {std::move(out)};
+    }
+
+    template<typename T>
+    bool rowAs(T& out)
+    {
+        settle();
+        if (!hasRow) {
+            return false;
+        }
+        decodeInto(out, columnIndex->rowPositions(&rowTag<T>, [this] {
+            return columnPositions<T>();
+        }));
+        step();
+        return true;
+    }
+
+    /**
+     * Input range decoding each row into one reused T, yielded as T const&:
+     *     for (Person const& person : resultSet.rowsAs<Person>()) { ... }
+     */
+    template<typename T>
+    class RowsAs
+    {
+        Resultset* resultset {};
+        std::array<int, rowMemberCount<T>> positions {};
+        T current {};
+
+    public:
+        class Iterator
+        {
+            RowsAs* range {};
+            Resultset::Iterator rows {};
+
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T const&;
+
+            Iterator() = default;
+
+            Iterator(RowsAs* range, Resultset::Iterator rows)
+                : range {range}
+                , rows {rows}
+            {
+                decode();
+            }
+
+            T const& operator*() const
+            {
+                return range->current;
+            }
+
+            T const* operator->() const
+            {
+                return &range->current;
+            }
+
+            Iterator& operator++()
+            {
+                ++rows;
+                decode();
+                return *this;
+            }
+
+            void operator++(int)
+            {
+                ++(*this);
+            }
+
+            bool operator==(Iterator const& other) const
+            {
+                return rows == other.rows;
+            }
+
+            bool operator!=(Iterator const& other) const
+            {
+                return rows != other.rows;
+            }
+
+        private:
+            void decode()
+            {
+                if (range != nullptr && rows != Resultset::Iterator {}) {
+                    range->resultset->decodeInto(range->current, range->positions);
+                }
+            }
+        };
+
+        explicit RowsAs(Resultset* resultset)
+            : resultset {resultset}
+            , positions {resultset->columnPositions<T>()}
+        {}
+
+        Iterator begin()
+        {
+            return {this, resultset->begin()};
+        }
+
+        Iterator end()
+        {
+            return {nullptr, resultset->end()};
+        }
+    };
+
+    template<typename T>
+    RowsAs<T> rowsAs()
+    {
+        return RowsAs<T> {this};
+    }
 
     template<typename T>
     std::optional<T> fieldT()
@@ -296,7 +1449,7 @@ public:
     }
 
     template<typename T>
-    std::optional<T> fieldT(SqlColName const& name)
+    std::optional<T> fieldT(std::string_view const name)
     {
         return fieldT<T>(posn(name));
     }
@@ -311,6 +1464,7 @@ public:
     template<typename... T>
     std::optional<std::tuple<std::optional<T>...>> rowT()
     {
+        settle();
         if (!hasRow) {
             return {};
         }
@@ -321,18 +1475,64 @@ public:
 
         checkTypeCount(std::tuple_size_v<std::tuple<T...>>);
 
-        auto tup = std::make_tuple(fieldT<T>(incPos())...);
+        // braced init guarantees left-to-right evaluation of incPos()
+        std::tuple<std::optional<T>...> tup {fieldT<T>(incPos())...};
         step();
         return {tup};
     }
 
+    /**
+     * Read up to batchSize rows into batch, replacing its contents but keeping its capacity.
+     * Column kinds are taken from batch if already set, else inferred from the current row
+     * (or declared type for NULLs). Returns rows read: 0 when the Resultset is exhausted.
+     * Throws if batchSize is 0, or if a text column's arena would pass its 32 bit offsets.
+     */
+    std::size_t fetchColumns(ColumnBatch& batch, std::size_t batchSize);
+    ColumnBatch fetchColumns(std::size_t batchSize);
+
     [[nodiscard]] int toFile(std::filesystem::path const& fileSpec,
                              FileReplace replace = FileReplace::no) const;
 
 private:
     void checkTypeCount(int count) const;
+    static void checkTypeCount(int count, int colCount);
+
+    template<typename T>
+    std::array<int, rowMemberCount<T>> columnPositions() const
+    {
+        std::array<int, rowMemberCount<T>> positions {};
+        if constexpr (hasColumnNames<RowMapping<T>>) {
+            static_assert(RowMapping<T>::columns.size() == rowMemberCount<T>,
+                          "RowMapping: columns and members differ in number");
+            for (std::size_t i = 0; i < positions.size(); ++i) {
+                positions[i] = posn(RowMapping<T>::columns[i]);
+            }
+        }
+        else {
+            checkTypeCount(static_cast<int>(positions.size()), countColumns());
+            for (std::size_t i = 0; i < positions.size(); ++i) {
+                positions[i] = static_cast<int>(i);
+            }
+        }
+        return positions;
+    }
+
+    template<typename T>
+    static constexpr char rowTag {};  // its address identifies T
+
+    template<typename T, typename Positions>
+    void decodeInto(T& out, Positions const& positions) const
+    {
+        std::size_t i {0};
+        std::apply(
+            [&](auto&... members) {
+                (assignColumn(members, stmnt, positions[i++]), ...);
+            },
+            RowMapping<T>::members(out));
+    }
     void step();
-    [[nodiscard]] int posn(SqlColName const& name) const;
+    void settle();  // complete an advance deferred by rowView()
+    [[nodiscard]] int posn(std::string_view name) const;
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -340,25 +1540,232 @@ private:
 class PreparedStatement
 {
     sqlite3_stmt* stmnt {};
+    StatementCache* cache {};  // non-null if leased from a cache
+    std::unique_ptr<ColumnIndex> ownedIndex {};
+    ColumnIndex* columnIndex {};  // ownedIndex, or the cache's if leased
 
 public:
     explicit PreparedStatement(sqlite3_stmt* stmnt);
+    PreparedStatement(StatementCache::Lease lease, StatementCache* cache);
     ~PreparedStatement();
     // rule of 5
     PreparedStatement() = delete;
     PreparedStatement(PreparedStatement&) = delete;
-    PreparedStatement(PreparedStatement&&) noexcept = default;
+    PreparedStatement(PreparedStatement&& other) noexcept;
     PreparedStatement& operator=(PreparedStatement&) = delete;
     PreparedStatement& operator=(PreparedStatement&&) = delete;
 
+    [[nodiscard]] StatementStats stats() const;
+    void resetStats();
+
     template<typename... Types>
-    Resultset execute(Types... values)
+    Resultset execute(Types&&... values)
     {
-        Binder {stmnt}.setParams(values...);
+        Binder {stmnt}.setParams(std::forward<Types>(values)...);
 
-        Resultset res {stmnt};
+        Resultset res {stmnt, *columnIndex};
         return res;
     }
+
+    /**
+     * Execute once per element of rows, reusing this statement and one binder.
+     * An element is a tuple-like of params (std::tuple, std::pair, std::array) or a single param.
+     * project maps an element, eg a struct, to its params:
+     *     [](auto& s) { return std::tie(s.a, s.b); }
+     *
+     * Runs inside one transaction, committed every commitInterval rows (0: once at the end),
+     * unless a transaction is already open, in which case the caller owns it.
+     * On error the open batch is rolled back and the exception rethrown.
+     * Returns rows affected.
+     */
+    template<typename Range,
+             typename Projection,
+             typename = std::enable_if_t<!std::is_integral_v<Projection>>>
+    std::size_t executeMany(Range&& rows, Projection project, std::size_t commitInterval = 0)
+    {
+        Binder binder {stmnt};
+        Batch batch {stmnt, commitInterval};
+        bool first {true};
+        for (auto&& row : rows) {
+            bindRow(binder, project(row), first);
+            first = false;
+            batch.step();
+        }
+        batch.commit();
+        return batch.changes();
+    }
+
+    template<typename Range>
+    std::size_t executeMany(Range&& rows, std::size_t const commitInterval = 0)
+    {
+        auto identity = [](auto const& row) -> auto const& {
+            return row;
+        };
+        return executeMany(std::forward<Range>(rows), identity, commitInterval);
+    }
+
+private:
+    /**
+     * Transaction and step handling for executeMany
+     */
+    class Batch
+    {
+        sqlite3_stmt* stmnt {};
+        sqlite3* db {};
+        std::size_t commitInterval {};
+        std::size_t pending {0};  // rows in the open transaction
+        std::size_t changeCount {0};
+        bool ownsTransaction {false};
+        sqlite3_stmt* begin {};  // prepared on first use, kept for every chunk
+        sqlite3_stmt* commitStmnt {};
+
+    public:
+        Batch(sqlite3_stmt* stmnt, std::size_t commitInterval);
+        ~Batch();
+        Batch(Batch&) = delete;
+        Batch& operator=(Batch&) = delete;
+
+        void step();
+        void commit();
+        [[nodiscard]] std::size_t changes() const;
+
+    private:
+        void exec(sqlite3_stmt*& control, char const* sql) const;
+    };
+
+    template<typename Params>
+    static void bindRow(Binder& binder, Params const& params, bool const checkCount)
+    {
+        if constexpr (isTupleLike<Params>) {
+            std::apply(
+                [&](auto const&... values) {
+                    checkCount ? binder.setParams(values...) : binder.rebind(values...);
+                },
+                params);
+        }
+        else {
+            checkCount ? binder.setParams(params) : binder.rebind(params);
+        }
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+template<typename Range>
+std::size_t Connection::executeMany(std::string const& queryStr,
+                                    Range&& rows,
+                                    std::size_t const commitInterval)
+{
+    return prepareCached(queryStr).executeMany(std::forward<Range>(rows), commitInterval);
+}
+
+template<typename Range, typename Projection, typename>
+std::size_t Connection::executeMany(std::string const& queryStr,
+                                    Range&& rows,
+                                    Projection project,
+                                    std::size_t const commitInterval)
+{
+    return prepareCached(queryStr).executeMany(std::forward<Range>(rows), project, commitInterval);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+class Transaction
+{
+    Connection* connection {};
+
+public:
+    Transaction(Connection& connection, TransactionMode mode);
+    ~Transaction();
+    Transaction() = delete;
+    Transaction(Transaction&) = delete;
+    Transaction(Transaction&& other) noexcept;
+    Transaction& operator=(Transaction&) = delete;
+    Transaction& operator=(Transaction&&) = delete;
+
+    void commit();
+    void rollback();
+    [[nodiscard]] bool active() const;
+};
+
+/**
+ * Nestable. Named by depth, so must be ended in LIFO order, which RAII scoping gives
+ */
+class Savepoint
+{
+    Connection* connection {};
+    std::string name {};
+
+public:
+    explicit Savepoint(Connection& connection);
+    ~Savepoint();
+    Savepoint() = delete;
+    Savepoint(Savepoint&) = delete;
+    Savepoint(Savepoint&& other) noexcept;
+    Savepoint& operator=(Savepoint&) = delete;
+    Savepoint& operator=(Savepoint&&) = delete;
+
+    void release();
+    void rollback();
+    [[nodiscard]] bool active() const;
+
+private:
+    void end();
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * RAII handle on sqlite3_blob. Streams transfer through one buffer of chunkSize bytes, so peak
+ * memory does not depend on blob size. A blob cannot change size: write into a ZeroBlob.
+ */
+class BlobStream
+{
+    sqlite3_blob* blob {};
+
+public:
+    static constexpr std::size_t defaultChunkSize {64 * 1024};
+
+    BlobStream(sqlite3* db,
+               std::string const& dbName,
+               std::string const& table,
+               std::string const& column,
+               sqlite3_int64 rowid,
+               bool writable);
+    ~BlobStream();
+    BlobStream() = delete;
+    BlobStream(BlobStream&) = delete;
+    BlobStream(BlobStream&& other) noexcept;
+    BlobStream& operator=(BlobStream&) = delete;
+    BlobStream& operator=(BlobStream&&) = delete;
+
+    [[nodiscard]] std::size_t size() const;
+
+    void write(void const* data, std::size_t count, std::size_t offset);
+    void read(void* data, std::size_t count, std::size_t offset) const;
+
+    /**
+     * Fill from the start of the blob until source or blob is exhausted. Returns bytes written
+     */
+    std::size_t writeFrom(std::istream& source, std::size_t chunkSize = defaultChunkSize);
+    std::size_t writeFrom(std::filesystem::path const& fileSpec,
+                          std::size_t chunkSize = defaultChunkSize);
+#ifndef _WIN32
+    std::size_t writeFrom(int fd, std::size_t chunkSize = defaultChunkSize);
+#endif
+
+    /**
+     * Copy the whole blob to sink. Returns bytes read
+     */
+    std::size_t readTo(std::ostream& sink, std::size_t chunkSize = defaultChunkSize) const;
+
+    /**
+     * Point at another row of the same table/column without reopening
+     */
+    void reopen(sqlite3_int64 rowid);
+
+private:
+    void checkResult(int res, char const* what) const;
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -0,0 +1,139 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#ifndef SQLITE_CPP_ALLOC_H
+#define SQLITE_CPP_ALLOC_H
+
+#include <atomic>
+#include <mutex>
+
+#include "cpp4sqlite.h"
+
+namespace cpp4sqlite
+{
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Memory allocator for sqlite, as for sqlite3_mem_methods. Must be thread safe.
+ * Blocks must be 8-byte aligned; size() is the usable size of a block from allocate().
+ */
+class Allocator
+{
+public:
+    virtual ~Allocator() = default;
+
+    virtual void* allocate(int size) = 0;
+    virtual void deallocate(void* block) = 0;
+    virtual void* reallocate(void* block, int size) = 0;
+    [[nodiscard]] virtual int size(void* block) = 0;
+
+    /**
+     * Size allocate() would actually provide for a request of size bytes
+     */
+    [[nodiscard]] virtual int roundup(int size);
+};
+
+/**
+ * Size-class pool: requests up to maxPooled bytes are served from per-thread free lists, refilled
+ * from and spilled to a shared depot in batches, so the common path takes no lock.
+ * Larger requests go straight to malloc. Memory is held for reuse until the allocator is
+ * destroyed (depot) or a thread exits (its cache).
+ */
+class PoolAllocator: public Allocator
+{
+public:
+    static constexpr int maxPooled {64 * 1024};
+    static constexpr std::size_t batchSize {32};  // blocks moved per refill / spill
+
+    struct Stats
+    {
+        std::size_t refills {};      // thread cache refilled from the depot
+        std::size_t spills {};       // thread cache overflowed to the depot
+        std::size_t systemAllocs {};  // pooled size classes served by malloc
+        std::size_t largeAllocs {};
+    };
+
+    PoolAllocator();
+    ~PoolAllocator() override;
+    PoolAllocator(PoolAllocator&) = delete;
+    PoolAllocator& operator=(PoolAllocator&) = delete;
+
+    void* allocate(int size) override;
+    void deallocate(void* block) override;
+    void* reallocate(void* block, int size) override;
+    [[nodiscard]] int size(void* block) override;
+    [[nodiscard]] int roundup(int size) override;
+
+    [[nodiscard]] Stats stats() const;
+
+    // size classes: 16 byte steps to 128, then 4 per power of two to maxPooled
+    [[nodiscard]] static int sizeClass(int size);  // -1 if not pooled
+    [[nodiscard]] static int classSize(int sizeClass);
+    static constexpr int classCount {8 + 9 * 4};
+
+private:
+    struct Depot
+    {
+        std::mutex mutex {};
+        std::vector<void*> blocks {};
+    };
+
+    std::unique_ptr<Depot[]> depots;
+    std::atomic<std::size_t> refills {0};
+    std::atomic<std::size_t> spills {0};
+    std::atomic<std::size_t> systemAllocs {0};
+    std::atomic<std::size_t> largeAllocs {0};
+    std::uint64_t const generation;  // tells this pool's thread caches from a predecessor's
+
+    void refill(int sizeClass, std::vector<void*>& cache);
+    void spill(int sizeClass, std::vector<void*>& cache);
+};
+
+/**
+ * RAII process-wide sqlite memory configuration. The constructor shuts sqlite down, applies the
+ * configuration and reinitialises; the destructor shuts down and restores the previous malloc
+ * methods. No connection may be open while either runs, and only one guard may exist at a time.
+ * The allocator must outlive the guard.
+ */
+class SqliteInit
+{
+public:
+    struct Heap
+    {
+        void* buffer {};
+        int size {};
+        int minAllocation {};  // power of two
+    };
+
+    explicit SqliteInit(Allocator& allocator);
+
+    /**
+     * SQLITE_CONFIG_HEAP: all sqlite memory from one fixed buffer.
+     * Needs sqlite built with SQLITE_ENABLE_MEMSYS5, else throws.
+     */
+    explicit SqliteInit(Heap heap);
+
+    ~SqliteInit();
+    SqliteInit() = delete;
+    SqliteInit(SqliteInit&) = delete;
+    SqliteInit(SqliteInit&&) = delete;
+    SqliteInit& operator=(SqliteInit&) = delete;
+    SqliteInit& operator=(SqliteInit&&) = delete;
+
+    [[nodiscard]] static bool heapSupported();
+
+private:
+    sqlite3_mem_methods previous {};
+
+    template<typename Configure>
+    void install(Configure configure);
+    void restore();
+};
+
+//--------------------------------------------------------------------------------------------------
+}  // namespace cpp4sqlite
+#endif  // SQLITE_CPP_ALLOC_H
@@ -0,0 +1,208 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#ifndef SQLITE_CPP_ASYNC_H
+#define SQLITE_CPP_ASYNC_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "cpp4sqlite.h"
+
+namespace cpp4sqlite
+{
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Param type held by a queued job: decayed, with char pointers and string_views copied as
+ * std::string. Borrowed params are refused, as the job outlives the caller's buffer.
+ */
+template<typename T, typename Decayed = std::decay_t<T>>
+struct OwnedParamOf
+{
+    static_assert(!std::is_same_v<Decayed, BorrowedText> && !std::is_same_v<Decayed, BorrowedBlob>,
+                  "OwnedParam: borrowed params cannot be queued, pass an owning type");
+
+    using type = std::conditional_t<std::is_same_v<Decayed, char const*>
+                                        || std::is_same_v<Decayed, char*>
+                                        || std::is_same_v<Decayed, std::string_view>,
+                                    std::string,
+                                    Decayed>;
+};
+
+template<typename T>
+using OwnedParam = typename OwnedParamOf<T>::type;
+
+/**
+ * Connection owned by a worker thread. Work is queued and runs in submission order; results
+ * come back through std::future. The queue is a bounded ring: submit() waits while it is full
+ * (throws if called from work, which would wait on itself), trySubmit() returns nullopt instead.
+ * The mutex is held only to move a job pointer in or out.
+ * The connection is opened NOMUTEX and is only touched by the worker: work must not keep
+ * references to it, or to statements or resultsets, past its own return.
+ * The destructor runs any queued work, then joins the worker.
+ */
+class AsyncConnection
+{
+public:
+    using RowBatch = std::vector<SqlValueRow>;
+    using OnBatch = std::function<void(SqlColNames const&, RowBatch&&)>;
+
+    static constexpr std::size_t defaultQueueDepth {1024};
+
+    AsyncConnection(std::string_view name,
+                    OpenOption option = OpenOption::READONLY,
+                    std::size_t queueDepth = defaultQueueDepth);
+    ~AsyncConnection();
+    AsyncConnection() = delete;
+    AsyncConnection(AsyncConnection&) = delete;
+    AsyncConnection(AsyncConnection&&) = delete;
+    AsyncConnection& operator=(AsyncConnection&) = delete;
+    AsyncConnection& operator=(AsyncConnection&&) = delete;
+
+    /**
+     * Run work(Connection&) on the worker; its result or exception is delivered by the future
+     */
+    template<typename Work>
+    [[nodiscard]] auto submit(Work&& work)
+    {
+        auto [job, future] = makeJob(std::forward<Work>(work));
+        enqueue(std::move(job), true);
+        return std::move(future);
+    }
+
+    template<typename Work>
+    [[nodiscard]] auto trySubmit(Work&& work)
+    {
+        auto [job, future] = makeJob(std::forward<Work>(work));
+        using Future = decltype(future);
+        return enqueue(std::move(job), false) ? std::optional<Future> {std::move(future)}
+                                              : std::nullopt;
+    }
+
+    /**
+     * Connection::executeScript on the worker
+     */
+    [[nodiscard]] std::future<std::vector<QueryResult>> executeScript(std::string queryStr);
+
+    /**
+     * Execute a cached statement with params and materialise all of its rows.
+     * Params are copied into the job; char pointers and string_views are copied as std::string.
+     */
+    template<typename... Types>
+    [[nodiscard]] std::future<QueryResult> query(std::string queryStr, Types&&... values)
+    {
+        return submit([queryStr = std::move(queryStr),
+                       values = std::tuple<OwnedParam<Types>...> {std::forward<Types>(values)...}](
+                          Connection& connection) {
+            auto statement = connection.prepareCached(queryStr);
+            auto resultset = std::apply(
+                [&](auto const&... params) {
+                    return statement.execute(params...);
+                },
+                values);
+            return resultset.fetchAll();
+        });
+    }
+
+    /**
+     * As query(), but rows are handed to onBatch, on the worker thread, batchRows at a time.
+     * The future gives the total row count.
+     */
+    template<typename... Types>
+    [[nodiscard]] std::future<std::size_t>
+    stream(std::string queryStr, std::size_t batchRows, OnBatch onBatch, Types&&... values)
+    {
+        return submit([queryStr = std::move(queryStr),
+                       batchRows = std::max<std::size_t>(batchRows, 1),
+                       onBatch = std::move(onBatch),
+                       values = std::tuple<OwnedParam<Types>...> {std::forward<Types>(values)...}](
+                          Connection& connection) {
+            auto statement = connection.prepareCached(queryStr);
+            auto resultset = std::apply(
+                [&](auto const&... params) {
+                    return statement.execute(params...);
+                },
+                values);
+            SqlColNames const columns = resultset.columnNames();
+            std::size_t total {};
+            RowBatch batch {};
+            batch.reserve(batchRows);
+            for (auto const& row : resultset) {
+                batch.push_back(row.values());
+                if (batch.size() == batchRows) {
+                    total += batch.size();
+                    onBatch(columns, std::move(batch));
+                    batch = {};
+                    batch.reserve(batchRows);
+                }
+            }
+            if (!batch.empty()) {
+                total += batch.size();
+                onBatch(columns, std::move(batch));
+            }
+            return total;
+        });
+    }
+
+    [[nodiscard]] std::size_t queueDepth() const;
+    [[nodiscard]] std::size_t pending() const;  // queued, not yet started
+
+private:
+    struct Job
+    {
+        virtual ~Job() = default;
+        virtual void run(Connection& connection) = 0;
+    };
+
+    template<typename Result>
+    struct Task: Job
+    {
+        std::packaged_task<Result(Connection&)> task;
+
+        template<typename Work>
+        explicit Task(Work&& work)
+            : task {std::forward<Work>(work)}
+        {}
+
+        void run(Connection& connection) override
+        {
+            task(connection);
+        }
+    };
+
+    Connection connection;
+    std::vector<std::unique_ptr<Job>> ring {};
+    std::size_t head {0};
+    std::size_t count {0};
+    bool stopping {false};
+    mutable std::mutex mutex {};
+    std::condition_variable notEmpty {};
+    std::condition_variable notFull {};
+    std::thread worker {};  // last: started once the rest is constructed
+
+    template<typename Work>
+    static auto makeJob(Work&& work)
+    {
+        using Result = std::invoke_result_t<std::decay_t<Work>&, Connection&>;
+        auto task = std::make_unique<Task<Result>>(std::forward<Work>(work));
+        auto future = task->task.get_future();
+        return std::pair {std::unique_ptr<Job> {std::move(task)}, std::move(future)};
+    }
+
+    bool enqueue(std::unique_ptr<Job> job, bool wait);
+    void run();
+};
+
+//--------------------------------------------------------------------------------------------------
+}  // namespace cpp4sqlite
+#endif  // SQLITE_CPP_ASYNC_H
@@ -0,0 +1,111 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#ifndef SQLITE_CPP_BACKUP_H
+#define SQLITE_CPP_BACKUP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "cpp4sqlite.h"
+
+namespace cpp4sqlite
+{
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Online backup of a live database through sqlite3_backup, a few pages per step with a pause
+ * between steps so writers get in. The source is only read-locked during a step. The copy is
+ * consistent: a write by another connection restarts it (so under continuous writes it may not
+ * finish: use vacuumInto()), a write through the source connection is applied to it.
+ * The source connection is used by run() / start()'s thread: it must not be NOMUTEX if used
+ * elsewhere meanwhile, and must outlive the Backup.
+ */
+class Backup
+{
+public:
+    struct Options
+    {
+        int pagesPerStep {100};  // negative: everything in one step
+        std::chrono::milliseconds pause {10};
+        std::string sourceName {"main"};
+        std::string destinationName {"main"};
+    };
+
+    struct Progress
+    {
+        int remaining {};  // pages, as of the latest step
+        int total {};
+        std::size_t steps {};
+    };
+
+    using OnProgress = std::function<void(Progress const&)>;
+
+    Backup(Connection& source, std::string const& destinationPath);
+    Backup(Connection& source, std::string const& destinationPath, Options options);
+    ~Backup();  // cancels and waits for start()'s thread
+    Backup() = delete;
+    Backup(Backup&) = delete;
+    Backup(Backup&&) = delete;
+    Backup& operator=(Backup&) = delete;
+    Backup& operator=(Backup&&) = delete;
+
+    /**
+     * Copy to completion on this thread, calling onProgress after each step. Returns false if
+     * cancel() stopped it. Throws on error.
+     */
+    bool run(OnProgress const& onProgress = {});
+
+    /**
+     * As run(), on a background thread. wait() joins it, returning run()'s result or rethrowing
+     * its error
+     */
+    void start(OnProgress onProgress = {});
+    bool wait();
+
+    /**
+     * Stop the copy in progress after the current step. The destination's partial copy is
+     * rolled back. A later run() or start() copies afresh
+     */
+    void cancel();
+
+    [[nodiscard]] Progress progress() const;
+
+    /**
+     * VACUUM INTO: a compacted snapshot in one statement, holding a read transaction throughout.
+     * Not restarted by concurrent writes; the destination must not exist
+     */
+    static void vacuumInto(Connection& source,
+                           std::string const& destinationPath,
+                           std::string const& sourceName = "main");
+
+private:
+    Connection& source;
+    Connection destination;
+    Options const options;
+
+    std::atomic<int> remaining {-1};
+    std::atomic<int> total {-1};
+    std::atomic<std::size_t> steps {0};
+
+    std::mutex mutex {};
+    std::condition_variable cancelled {};
+    bool cancelRequested {false};
+    bool completed {false};  // by start()'s thread
+    std::exception_ptr error {};
+    std::thread worker {};
+
+    bool copy(OnProgress const& onProgress);
+};
+
+//--------------------------------------------------------------------------------------------------
+}  // namespace cpp4sqlite
+#endif  // SQLITE_CPP_BACKUP_H
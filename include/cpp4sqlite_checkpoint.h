@@ -0,0 +1,97 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#ifndef SQLITE_CPP_CHECKPOINT_H
+#define SQLITE_CPP_CHECKPOINT_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "cpp4sqlite.h"
+
+namespace cpp4sqlite
+{
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * WAL checkpoints on a background thread, off the commit path.
+ * watch() replaces a writer connection's auto-checkpoint with a sqlite3_wal_hook that only
+ * records the WAL size and wakes the thread. The thread checkpoints through its own connection:
+ * PASSIVE, escalating to RESTART then TRUNCATE as the WAL passes the larger thresholds (these
+ * wait up to busyTimeout for readers and writers, so bound the WAL when readers keep PASSIVE
+ * from finishing). A checkpoint that stays busy, or fails, is retried on the next commit.
+ * Only main is checkpointed: a watched connection's attached WAL databases go without.
+ * Watched connections must be unwatched, or the scheduler destroyed, before they close.
+ * Connection::configure() with walAutocheckpoint replaces the hook.
+ */
+class CheckpointScheduler
+{
+public:
+    struct Thresholds
+    {
+        int passivePages {1000};  // sqlite's auto-checkpoint default
+        int restartPages {4000};
+        int truncatePages {16000};
+        std::chrono::milliseconds busyTimeout {1000};
+    };
+
+    struct Stats
+    {
+        int walPages {};               // frames in the WAL after the latest commit
+        std::uintmax_t walFileBytes {};  // size of the -wal file now
+        std::size_t commits {};
+        std::size_t passive {};
+        std::size_t restart {};
+        std::size_t truncate {};
+        std::size_t busy {};  // checkpoints that could not complete, or failed
+        int lastLogFrames {};
+        int lastCheckpointedFrames {};
+        std::chrono::nanoseconds lastDuration {};
+        std::chrono::nanoseconds maxDuration {};
+        std::chrono::nanoseconds totalDuration {};
+    };
+
+    explicit CheckpointScheduler(std::string const& path);
+    CheckpointScheduler(std::string const& path, Thresholds thresholds);
+    ~CheckpointScheduler();
+    CheckpointScheduler() = delete;
+    CheckpointScheduler(CheckpointScheduler&) = delete;
+    CheckpointScheduler(CheckpointScheduler&&) = delete;
+    CheckpointScheduler& operator=(CheckpointScheduler&) = delete;
+    CheckpointScheduler& operator=(CheckpointScheduler&&) = delete;
+
+    void watch(Connection& writer);
+
+    /**
+     * Remove the hook, restoring sqlite's default auto-checkpoint
+     */
+    void unwatch(Connection& writer);
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    std::string const walPath;
+    Thresholds const thresholds;
+    Connection connection;  // touched only by the worker after construction
+
+    mutable std::mutex mutex {};
+    std::condition_variable wake {};
+    bool stopping {false};
+    bool pending {false};
+    std::vector<sqlite3*> watched {};
+    Stats counters {};
+    std::thread worker {};
+
+    static int walHook(void* scheduler, sqlite3* db, char const* dbName, int pages);
+    void run();
+    void checkpoint(int pages);
+};
+
+//--------------------------------------------------------------------------------------------------
+}  // namespace cpp4sqlite
+#endif  // SQLITE_CPP_CHECKPOINT_H
@@ -0,0 +1,271 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#ifndef SQLITE_CPP_CORO_H
+#define SQLITE_CPP_CORO_H
+
+// C++20 layer: link cpp4sqlite_coro rather than cpp4sqlite to use it
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <optional>
+
+#include "cpp4sqlite_async.h"
+
+namespace cpp4sqlite
+{
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Lazy input range of T produced by a coroutine with co_yield. Each value is valid until the
+ * iterator is incremented. An exception thrown by the coroutine is rethrown by begin() or ++.
+ */
+template<typename T>
+class Generator
+{
+public:
+    struct promise_type
+    {
+        T const* current {};
+        std::exception_ptr error {};
+
+        Generator get_return_object()
+        {
+            return Generator {std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always yield_value(T const& value) noexcept
+        {
+            current = &value;
+            return {};
+        }
+
+        void return_void() noexcept
+        {}
+
+        void unhandled_exception()
+        {
+            error = std::current_exception();
+        }
+
+        template<typename U>
+        std::suspend_never await_transform(U&&) = delete;  // no co_await in a generator
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class Iterator
+    {
+        Handle coro {};
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T const*;
+        using reference = T const&;
+
+        Iterator() = default;
+
+        explicit Iterator(Handle coro)
+            : coro {coro}
+        {
+            advance();
+        }
+
+        T const& operator*() const
+        {
+            return *coro.promise().current;
+        }
+
+        Iterator& operator++()
+        {
+            advance();
+            return *this;
+        }
+
+        void operator++(int)
+        {
+            advance();
+        }
+
+        bool operator==(std::default_sentinel_t) const
+        {
+            return !coro || coro.done();
+        }
+
+    private:
+        void advance()
+        {
+            coro.resume();
+            if (coro.done() && coro.promise().error) {
+                std::rethrow_exception(std::exchange(coro.promise().error, nullptr));
+            }
+        }
+    };
+
+    explicit Generator(Handle coro)
+        : coro {coro}
+    {}
+
+    ~Generator()
+    {
+        if (coro) {
+            coro.destroy();
+        }
+    }
+
+    Generator(Generator const&) = delete;
+    Generator& operator=(Generator const&) = delete;
+
+    Generator(Generator&& other) noexcept
+        : coro {std::exchange(other.coro, {})}
+    {}
+
+    Generator& operator=(Generator&&) = delete;
+
+    Iterator begin()
+    {
+        return Iterator {coro};
+    }
+
+    std::default_sentinel_t end()
+    {
+        return {};
+    }
+
+private:
+    Handle coro {};
+};
+
+/**
+ * Execute statement with params and yield its rows as they are stepped. The generator owns the
+ * statement, so may be returned or stored:
+ *     for (RowView const& row : rows(connection.prepareCached(sql), id)) { ... }
+ * Params are bound by begin(): pointers among them must stay valid until then.
+ */
+template<typename... Types>
+Generator<RowView> rows(PreparedStatement statement, Types... values)
+{
+    auto resultset = statement.execute(values...);
+    for (RowView const& row : resultset) {
+        co_yield row;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Resumes a coroutine once its work has completed, eg by posting it to the caller's executor.
+ * Empty: resume inline on the AsyncConnection worker. A coroutine so resumed must not block,
+ * and co_awaiting the same AsyncConnection from there throws rather than waits if its queue is
+ * full.
+ */
+using Resumer = std::function<void(std::coroutine_handle<>)>;
+
+/**
+ * co_await-able: runs work(Connection&) on an AsyncConnection worker while the awaiting
+ * coroutine is suspended, then resumes it with the result or rethrows the work's exception.
+ */
+template<typename Work>
+class Awaitable
+{
+public:
+    using Result = std::invoke_result_t<Work&, Connection&>;
+
+    Awaitable(AsyncConnection& async, Work work, Resumer resumer)
+        : async {async}
+        , work {std::move(work)}
+        , resumer {std::move(resumer)}
+    {}
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> awaiting)
+    {
+        // nothing here may touch *this once the worker could have resumed the coroutine
+        (void)async.submit([this, awaiting](Connection& connection) {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    work(connection);
+                }
+                else {
+                    result.emplace(work(connection));
+                }
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+            // the resumer may go on running after the coroutine, and *this with it, is gone
+            Resumer const resume {std::move(resumer)};
+            resume ? resume(awaiting) : awaiting.resume();
+        });
+    }
+
+    Result await_resume()
+    {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        if constexpr (!std::is_void_v<Result>) {
+            return std::move(*result);
+        }
+    }
+
+private:
+    struct Empty
+    {};
+
+    AsyncConnection& async;
+    Work work;
+    Resumer resumer;
+    std::conditional_t<std::is_void_v<Result>, Empty, std::optional<Result>> result {};
+    std::exception_ptr error {};
+};
+
+template<typename Work>
+[[nodiscard]] Awaitable<Work> awaitWork(AsyncConnection& async, Work work, Resumer resumer = {})
+{
+    return {async, std::move(work), std::move(resumer)};
+}
+
+/**
+ * As AsyncConnection::query(), awaited:
+ *     QueryResult const result = co_await execute(async, resumer, sql, id);
+ */
+template<typename... Types>
+[[nodiscard]] auto
+execute(AsyncConnection& async, Resumer resumer, std::string queryStr, Types... values)
+{
+    return awaitWork(
+        async,
+        [queryStr = std::move(queryStr),
+         ... values = OwnedParam<Types> {std::move(values)}](Connection& connection) {
+            auto statement = connection.prepareCached(queryStr);
+            return statement.execute(values...).fetchAll();
+        },
+        std::move(resumer));
+}
+
+//--------------------------------------------------------------------------------------------------
+}  // namespace cpp4sqlite
+#endif  // SQLITE_CPP_CORO_H
@@ -0,0 +1,119 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#ifndef SQLITE_CPP_PCACHE_H
+#define SQLITE_CPP_PCACHE_H
+
+#include <atomic>
+#include <mutex>
+
+#include "cpp4sqlite.h"
+
+namespace cpp4sqlite
+{
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Page cache for every connection in the process, with one memory budget for all of them.
+ * sqlite creates a cache per pager (connection and database); each is assigned to one of a
+ * number of shards, round robin, and its pages live there under the shard's lock. When the budget
+ * is reached a shard evicts its own least recently used unpinned pages by CLOCK before growing,
+ * else another shard's, round robin over those whose lock is free.
+ * Caches of temporary and in-memory databases are never evicted but count towards the budget.
+ * PRAGMA cache_size is ignored: the budget governs.
+ * Pages cannot be shared between pagers (sqlite keeps per-pager state in them), so the gain is
+ * in spending one budget where the pages are hot rather than fixed sizes per connection.
+ */
+class PageCache
+{
+public:
+    struct Stats
+    {
+        std::size_t budget {};
+        std::size_t bytes {};
+        std::size_t pages {};
+        std::size_t hits {};
+        std::size_t misses {};
+        std::size_t evictions {};
+        std::size_t overBudget {};  // pages allocated past the budget, nothing being evictable
+    };
+
+    /**
+     * One sqlite cache: per connection counters. Connection::status() reports the same hits
+     * and misses from the connection's side.
+     */
+    struct CacheStats
+    {
+        int pageSize {};
+        bool purgeable {};
+        std::size_t pages {};
+        std::size_t hits {};
+        std::size_t misses {};
+    };
+
+    explicit PageCache(std::size_t budgetBytes, std::size_t shardCount = 16);
+    ~PageCache();
+    PageCache(PageCache&) = delete;
+    PageCache& operator=(PageCache&) = delete;
+
+    [[nodiscard]] Stats stats() const;
+    [[nodiscard]] std::vector<CacheStats> caches() const;
+
+private:
+    friend class PageCacheInit;
+
+    struct Page;
+    struct Cache;
+    struct Shard;
+
+    std::size_t const budget;
+    std::vector<std::unique_ptr<Shard>> shards {};
+    std::atomic<std::size_t> nextShard {0};
+    std::atomic<std::size_t> nextVictim {0};  // first shard tried by evictElsewhere
+    std::atomic<std::size_t> bytes {0};
+
+    // sqlite3_pcache_methods2, dispatched to the installed PageCache
+    static sqlite3_pcache* create(int pageSize, int extraSize, int purgeable);
+    static void cachesize(sqlite3_pcache* cache, int pages);
+    static int pagecount(sqlite3_pcache* cache);
+    static sqlite3_pcache_page* fetch(sqlite3_pcache* cache, unsigned key, int createFlag);
+    static void unpin(sqlite3_pcache* cache, sqlite3_pcache_page* page, int discard);
+    static void rekey(sqlite3_pcache* cache, sqlite3_pcache_page* page, unsigned from, unsigned to);
+    static void truncate(sqlite3_pcache* cache, unsigned limit);
+    static void destroy(sqlite3_pcache* cache);
+    static void shrink(sqlite3_pcache* cache);
+
+    Page* allocate(Cache& cache, int createFlag);
+    bool reserve(std::size_t size);  // add size to bytes if within budget
+    void release(Cache& cache, Page* page);  // caller holds the shard lock
+    bool evictOne(Shard& shard, std::size_t pageBytes, Page*& reusable);
+    bool evictElsewhere(Shard const& own, std::size_t pageBytes, Page*& reusable);
+};
+
+/**
+ * RAII: installs a PageCache through SQLITE_CONFIG_PCACHE2, restoring sqlite's own on
+ * destruction. As for SqliteInit, no connection may be open while either runs, and only one
+ * may exist at a time. The PageCache must outlive it.
+ */
+class PageCacheInit
+{
+public:
+    explicit PageCacheInit(PageCache& pageCache);
+    ~PageCacheInit();
+    PageCacheInit() = delete;
+    PageCacheInit(PageCacheInit&) = delete;
+    PageCacheInit(PageCacheInit&&) = delete;
+    PageCacheInit& operator=(PageCacheInit&) = delete;
+    PageCacheInit& operator=(PageCacheInit&&) = delete;
+
+private:
+    sqlite3_pcache_methods2 previous {};
+};
+
+//--------------------------------------------------------------------------------------------------
+}  // namespace cpp4sqlite
+#endif  // SQLITE_CPP_PCACHE_H
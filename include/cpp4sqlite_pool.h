@@ -0,0 +1,111 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#ifndef SQLITE_CPP_POOL_H
+#define SQLITE_CPP_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "cpp4sqlite.h"
+
+namespace cpp4sqlite
+{
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Pool of connections to one database file in WAL mode: N read-only connections and one writer.
+ * WAL lets the readers run concurrently with each other and with the writer.
+ * Each connection is opened NOMUTEX and has its own statement cache; a checked out handle is
+ * for use by one thread at a time. Handles must not outlive the pool.
+ */
+class ConnectionPool
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Metrics
+    {
+        std::size_t checkouts {};
+        std::size_t exhausted {};  // checkouts that had to wait for a free connection
+        std::size_t timeouts {};
+        Clock::duration totalWait {};
+        Clock::duration maxWait {};
+    };
+
+    /**
+     * Checked out connection, returned to the pool on destruction
+     */
+    class Handle
+    {
+        ConnectionPool* pool {};
+        Connection* connection {};
+
+    public:
+        Handle(ConnectionPool* pool, Connection* connection);
+        ~Handle();
+        Handle() = delete;
+        Handle(Handle&) = delete;
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&) = delete;
+        Handle& operator=(Handle&&) = delete;
+
+        Connection& operator*() const;
+        Connection* operator->() const;
+    };
+
+    static constexpr std::chrono::milliseconds defaultTimeout {5000};
+
+    /**
+     * 5s busy timeout, so a connection waits out another's lock rather than failing SQLITE_BUSY
+     */
+    static ConnectionConfig defaultConfig();
+
+    /**
+     * config is applied to every connection; its journalMode is ignored as the pool always uses WAL
+     */
+    ConnectionPool(std::string const& path,
+                   std::size_t readerCount,
+                   std::size_t statementCacheCapacity = Connection::defaultStatementCacheCapacity,
+                   ConnectionConfig const& config = defaultConfig());
+    ~ConnectionPool();
+    ConnectionPool() = delete;
+    ConnectionPool(ConnectionPool&) = delete;
+    ConnectionPool(ConnectionPool&&) = delete;
+    ConnectionPool& operator=(ConnectionPool&) = delete;
+    ConnectionPool& operator=(ConnectionPool&&) = delete;
+
+    /**
+     * Wait up to timeout for a free connection, else throw
+     */
+    [[nodiscard]] Handle reader(std::chrono::milliseconds timeout = defaultTimeout);
+    [[nodiscard]] Handle writer(std::chrono::milliseconds timeout = defaultTimeout);
+
+    [[nodiscard]] std::size_t readerCount() const;
+    [[nodiscard]] std::size_t idleReaders() const;
+    [[nodiscard]] Metrics metrics() const;
+    void resetMetrics();
+
+private:
+    std::unique_ptr<Connection> writerConnection {};
+    std::vector<std::unique_ptr<Connection>> readers {};
+
+    mutable std::mutex mutex {};
+    std::condition_variable released {};
+    std::vector<Connection*> idle {};  // readers available for checkout
+    bool writerIdle {true};
+    Metrics counters {};
+
+    Connection* checkout(bool writer, std::chrono::milliseconds timeout);
+    void checkin(Connection* connection);
+};
+
+//--------------------------------------------------------------------------------------------------
+}  // namespace cpp4sqlite
+#endif  // SQLITE_CPP_POOL_H
@@ -0,0 +1,85 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#ifndef SQLITE_CPP_PROFILE_H
+#define SQLITE_CPP_PROFILE_H
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+#include "cpp4sqlite.h"
+
+namespace cpp4sqlite
+{
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Log-linear histogram of nanosecond latencies: 8 linear sub-buckets per power of two, so a
+ * bucket's width is at most 12.5% of its values. record() is wait-free (relaxed atomics);
+ * snapshot() may run concurrently and sees each counter at some recent value.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr int subBucketBits {3};
+    static constexpr int subBuckets {1 << subBucketBits};
+    static constexpr int bucketCount {(64 - subBucketBits + 1) * subBuckets};
+
+    void record(std::uint64_t nanos);
+    void reset();
+
+    /**
+     * Fills all of profile but its sql
+     */
+    void snapshot(QueryProfile& profile) const;
+
+    [[nodiscard]] static int bucketOf(std::uint64_t nanos);
+    [[nodiscard]] static std::uint64_t upperBound(int bucket);  // largest value in bucket
+
+private:
+    std::array<std::atomic<std::uint64_t>, bucketCount> counts {};
+    std::atomic<std::uint64_t> total {0};
+    std::atomic<std::uint64_t> max {0};
+};
+
+/**
+ * Histograms per query shape, fed from a sqlite3_trace_v2 SQLITE_TRACE_PROFILE callback.
+ * record() runs on whichever thread is using the connection; it resolves the statement's sql to
+ * its histogram through a cache only that thread touches, and locks only to add a new shape.
+ */
+class Profiler
+{
+public:
+    void record(sqlite3_stmt* stmnt, std::uint64_t nanos);
+
+    [[nodiscard]] std::vector<QueryProfile> snapshot() const;
+    void reset();
+
+    /**
+     * Literals replaced by ?, comments dropped, whitespace runs collapsed to one space
+     */
+    [[nodiscard]] static std::string normalise(std::string_view sql);
+
+    static int traceCallback(unsigned type, void* context, void* stmnt, void* nanos);
+
+private:
+    static constexpr std::size_t seenLimit {4096};  // raw sql variants cached before a flush
+
+    mutable std::mutex mutex {};  // guards shapes
+    std::unordered_map<std::string, std::unique_ptr<LatencyHistogram>> shapes {};
+
+    // recording thread only: raw sql text -> its shape's histogram
+    std::deque<std::string> seenSql {};
+    std::unordered_map<std::string_view, LatencyHistogram*> seen {};
+
+    LatencyHistogram* histogramFor(std::string_view sql);
+};
+
+//--------------------------------------------------------------------------------------------------
+}  // namespace cpp4sqlite
+#endif  // SQLITE_CPP_PROFILE_H
@@ -5,11 +5,187 @@
  */
 
 #include "cpp4sqlite.h"
+#include "cpp4sqlite_profile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 using namespace cpp4sqlite;
 
 //--------------------------------------------------------------------------------------------------
 
+ConnectionConfig ConnectionConfig::readHeavy()
+{
+    ConnectionConfig config {};
+    config.journalMode = JournalMode::wal;
+    config.synchronous = Synchronous::normal;
+    config.cacheSize = -64 * 1024;
+    config.mmapSize = 256 * 1024 * 1024;
+    config.tempStore = TempStore::memory;
+    config.busyTimeout = std::chrono::seconds {5};
+    return config;
+}
+
+ConnectionConfig ConnectionConfig::bulkIngest()
+{
+    ConnectionConfig config {};
+    config.journalMode = JournalMode::wal;
+    config.synchronous = Synchronous::off;
+    config.cacheSize = -256 * 1024;
+    config.tempStore = TempStore::memory;
+    config.walAutocheckpoint = 10000;
+    config.foreignKeys = false;
+    return config;
+}
+
+ConnectionConfig ConnectionConfig::durable()
+{
+    ConnectionConfig config {};
+    config.journalMode = JournalMode::wal;
+    config.synchronous = Synchronous::full;
+    config.busyTimeout = std::chrono::seconds {5};
+    config.foreignKeys = true;
+    return config;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * State behind a BusyPolicy. The sqlite callback runs under the connection's mutex; backoff()
+ * may also run from retryBusy() on any thread, so the counters are atomic.
+ */
+class cpp4sqlite::BusyHandler
+{
+public:
+    BusyPolicy const policy;
+
+    explicit BusyHandler(BusyPolicy const& policy)
+        : policy {policy}
+    {}
+
+    static int callback(void* handler, int const count)
+    {
+        auto& self = *static_cast<BusyHandler*>(handler);
+        if (count == 0) {
+            self.episodeStart = std::chrono::steady_clock::now();
+            self.gaveUp.store(false, std::memory_order_relaxed);
+        }
+        if (self.backoff(count, self.episodeStart)) {
+            return 1;
+        }
+        self.gaveUp.store(true, std::memory_order_relaxed);
+        return 0;
+    }
+
+    /**
+     * Sleep before the given attempt of an episode begun at start; false if that would pass the
+     * timeout
+     */
+    bool backoff(int const attempt, std::chrono::steady_clock::time_point const start)
+    {
+        thread_local std::minstd_rand random {std::random_device {}()};
+        double const scale {1.0 - policy.jitter * std::uniform_real_distribution {}(random)};
+        double const delay {std::min(static_cast<double>(policy.maxDelay.count()),
+                                     static_cast<double>(policy.initialDelay.count())
+                                         * std::pow(policy.multiplier, attempt))};
+        std::chrono::microseconds const wait {static_cast<std::int64_t>(delay * scale)};
+
+        auto const now = std::chrono::steady_clock::now();
+        if (now - start + wait > policy.timeout) {
+            timeouts.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::this_thread::sleep_for(wait);
+        auto const slept = std::chrono::steady_clock::now() - now;
+        waits.fetch_add(1, std::memory_order_relaxed);
+        blockedNanos.fetch_add(std::chrono::nanoseconds {slept}.count(), std::memory_order_relaxed);
+        return true;
+    }
+
+    [[nodiscard]] BusyStats stats() const
+    {
+        return {waits.load(std::memory_order_relaxed), retries.load(std::memory_order_relaxed),
+                timeouts.load(std::memory_order_relaxed),
+                std::chrono::nanoseconds {blockedNanos.load(std::memory_order_relaxed)}};
+    }
+
+    std::atomic<std::uint64_t> retries {0};
+    std::atomic<bool> gaveUp {false};  // the last SQLITE_BUSY has had its full timeout
+
+private:
+    std::chrono::steady_clock::time_point episodeStart {};
+    std::atomic<std::uint64_t> waits {0};
+    std::atomic<std::uint64_t> timeouts {0};
+    std::atomic<std::int64_t> blockedNanos {0};
+};
+
+namespace
+{
+// retryBusy() has only the statement: it finds the policy of the statement's connection here
+std::mutex busyHandlersMutex {};
+std::unordered_map<sqlite3*, BusyHandler*> busyHandlers {};
+
+BusyHandler* busyHandlerOf(sqlite3* db)
+{
+    std::lock_guard lock {busyHandlersMutex};
+    auto const found = busyHandlers.find(db);
+    return found == busyHandlers.end() ? nullptr : found->second;
+}
+
+bool isCommit(sqlite3_stmt* stmnt)
+{
+    std::string_view const sql {fixNullStr(sqlite3_sql(stmnt))};
+    auto startsWith = [&sql](std::string_view const word) {
+        return sql.size() >= word.size()
+               && std::equal(word.begin(), word.end(), sql.begin(), [](char const a, char const b) {
+                      return a == std::toupper(static_cast<unsigned char>(b));
+                  });
+    };
+    return startsWith("COMMIT") || startsWith("END");
+}
+
+/**
+ * Rerun a statement that failed SQLITE_BUSY / SQLITE_LOCKED while its connection's policy allows
+ * and rerunning is safe. Returns the final result code.
+ */
+int retryBusy(sqlite3_stmt* stmnt, int res)
+{
+    sqlite3* const db {sqlite3_db_handle(stmnt)};
+    BusyHandler* const handler {busyHandlerOf(db)};
+    if (handler == nullptr || handler->gaveUp.exchange(false, std::memory_order_relaxed)) {
+        return res;
+    }
+    auto const start = std::chrono::steady_clock::now();
+    for (int attempt = 0; (res == SQLITE_BUSY || res == SQLITE_LOCKED)
+                          && attempt < handler->policy.stepRetries;
+         ++attempt) {
+        if (sqlite3_get_autocommit(db) == 0 && !isCommit(stmnt)) {
+            break;  // within a transaction: the caller must roll back
+        }
+        if (!handler->backoff(attempt, start)) {
+            break;
+        }
+        sqlite3_reset(stmnt);
+        handler->retries.fetch_add(1, std::memory_order_relaxed);
+        res = sqlite3_step(stmnt);
+    }
+    return res;
+}
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+
 Connection::Connection(std::string_view const name, OpenOption flags, char const* vfs)
 {
     if (auto const res {sqlite3_open_v2(name.data(), &sqliteDb, static_cast<int>(flags), vfs)}) {
@@ -19,6 +195,15 @@ Connection::Connection(std::string_view const name, OpenOption flags, char const
     }
 }
 
+Connection::Connection(std::string_view const name,
+                       OpenOption const flags,
+                       ConnectionConfig const& config,
+                       char const* vfs)
+    : Connection(name, flags, vfs)
+{
+    configure(config);
+}
+
 void Connection::close() const
 {
     sqlite3_close(sqliteDb);
@@ -26,9 +211,40 @@ void Connection::close() const
 
 Connection::~Connection()
 {
+    statementCache.clear();
+    clearBusyPolicy();
     close();
 }
 
+void Connection::setBusyPolicy(BusyPolicy const& policy)
+{
+    auto handler = std::make_unique<BusyHandler>(policy);
+    sqlite3_busy_handler(sqliteDb, BusyHandler::callback, handler.get());
+    {
+        std::lock_guard lock {busyHandlersMutex};
+        busyHandlers[sqliteDb] = handler.get();
+    }
+    busyHandler = std::move(handler);
+}
+
+void Connection::clearBusyPolicy()
+{
+    if (busyHandler == nullptr) {
+        return;
+    }
+    sqlite3_busy_handler(sqliteDb, nullptr, nullptr);
+    {
+        std::lock_guard lock {busyHandlersMutex};
+        busyHandlers.erase(sqliteDb);
+    }
+    busyHandler.reset();
+}
+
+BusyStats Connection::busyStats() const
+{
+    return busyHandler == nullptr ? BusyStats {} : busyHandler->stats();
+}
+
 std::string Connection::errorStr() const
 {
     return {sqlite3_errmsg(sqliteDb)};
@@ -39,26 +255,91 @@ int Connection::affectedRows() const
     return sqlite3_changes(sqliteDb);
 }
 
-SqlTable Connection::quickQuery(std::string const& queryStr)
+/**
+ * Prepare each statement of queryStr in turn via the tail pointer, call onStatement once,
+ * step it calling onRow per row, then finalize it
+ */
+template<typename OnStatement, typename OnRow>
+void Connection::forEachStatement(std::string_view const queryStr,
+                                  char const* what,
+                                  OnStatement onStatement,
+                                  OnRow onRow)
 {
-    results.clear();  // updated by callback
-    char* error;
-    sqlite3_exec(sqliteDb, queryStr.c_str(), &callback, this, &error);
-    errorMsg = fixNullStr(error);
-    if (!errorMsg.empty()) {
-        throw std::runtime_error("Connection::QuickQuery error: " + errorMsg);
+    errorMsg.clear();
+    auto fail = [&] {
+        errorMsg = sqlite3_errmsg(sqliteDb);
+        throw std::runtime_error(what + errorMsg);
+    };
+
+    char const* tail = queryStr.data();
+    char const* const end = tail + queryStr.size();
+    while (tail < end) {
+        sqlite3_stmt* stmnt {};
+        auto const size = static_cast<int>(end - tail);
+        if (sqlite3_prepare_v3(sqliteDb, tail, size, 0, &stmnt, &tail) != SQLITE_OK) {
+            fail();
+        }
+        if (stmnt == nullptr) {
+            continue;  // whitespace or comment
+        }
+        std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> const guard {stmnt,
+                                                                               &sqlite3_finalize};
+        onStatement(stmnt);
+        int res {sqlite3_step(stmnt)};
+        if (res == SQLITE_BUSY || res == SQLITE_LOCKED) {
+            res = retryBusy(stmnt, res);
+        }
+        while (res == SQLITE_ROW) {
+            onRow(stmnt);
+            res = sqlite3_step(stmnt);
+        }
+        if (res != SQLITE_DONE) {
+            fail();
+        }
     }
-    return results;
 }
 
-int Connection::processSqlite3Callback(int const count, char** values, char** names)
+SqlTable Connection::quickQuery(std::string const& queryStr)
 {
-    SqlRow row {};
-    for (int i = 0; i < count; ++i) {
-        row.emplace_back(names[i], fixNullStr(values[i]));
-    }
-    results.push_back(row);
-    return 0;
+    SqlTable table {};
+    auto onStatement = [](sqlite3_stmt*) {};
+    auto onRow = [&](sqlite3_stmt* stmnt) {
+        int const count = sqlite3_column_count(stmnt);
+        SqlRow& row = table.emplace_back();
+        row.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            row.emplace_back(sqlite3_column_name(stmnt, i),
+                             columnValue<std::string_view>(stmnt, i));
+        }
+    };
+    forEachStatement(queryStr, "Connection::QuickQuery error: ", onStatement, onRow);
+    return table;
+}
+
+std::vector<QueryResult> Connection::executeScript(std::string_view const queryStr)
+{
+    std::vector<QueryResult> results {};
+    auto onStatement = [&](sqlite3_stmt* stmnt) {
+        int const count = sqlite3_column_count(stmnt);
+        if (count == 0) {
+            return;
+        }
+        QueryResult& result = results.emplace_back();
+        result.columns.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            result.columns.emplace_back(sqlite3_column_name(stmnt, i));
+        }
+    };
+    auto onRow = [&](sqlite3_stmt* stmnt) {
+        int const count = sqlite3_column_count(stmnt);
+        SqlValueRow& row = results.back().rows.emplace_back();
+        row.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            row.push_back(columnValue<SqlValue>(stmnt, i));
+        }
+    };
+    forEachStatement(queryStr, "Connection::executeScript error: ", onStatement, onRow);
+    return results;
 }
 
 PreparedStatement Connection::prepare(std::string const& queryStr, int const prepFlags) const
@@ -75,254 +356,1405 @@ PreparedStatement Connection::prepare(std::string const& queryStr, int const pre
     return pStmnt;
 }
 
-int Connection::lastInsertId() const
+PreparedStatement Connection::prepareCached(std::string const& queryStr)
 {
-    return static_cast<int>(sqlite3_last_insert_rowid(sqliteDb));
+    if (auto const lease = statementCache.acquire(sqliteDb, queryStr); lease.stmnt != nullptr) {
+        return {lease, &statementCache};
+    }
+    return prepare(queryStr);
 }
 
-bool Connection::getAutocommit() const
+void Connection::execCached(std::string const& queryStr)
 {
-    return sqlite3_get_autocommit(sqliteDb) > 0;
+    (void)prepareCached(queryStr).execute();
 }
 
-//--------------------------------------------------------------------------------------------------
-
-Binder::Binder(sqlite3_stmt* stmnt)
-    : stmnt {stmnt}
-{}
+Transaction Connection::transaction(TransactionMode const mode)
+{
+    return {*this, mode};
+}
 
-void Binder::reset()
+Savepoint Connection::savepoint()
 {
-    if (int const res {sqlite3_reset(stmnt)}) {
-        throw std::runtime_error(std::string {"Binder::reset error: "} + errString(res));
-    }
-    bindPosn = 0;
+    return Savepoint {*this};
 }
 
-void Binder::checkBindParamCount(std::size_t const size) const
+void Connection::setStatementCacheCapacity(std::size_t const capacity)
 {
-    if (std::size_t const count {static_cast<std::size_t>(sqlite3_bind_parameter_count(stmnt))};
-        size != count) {
-        throw std::runtime_error(size > count ? "too many bind params" : "too few bind params");
-    }
+    statementCache.setCapacity(capacity);
 }
 
-void Binder::bindInt(int const param) const
+StatementCache::Stats Connection::statementCacheStats() const
 {
-    checkResult(sqlite3_bind_int(stmnt, bindPosn, param));
+    return statementCache.stats();
 }
 
-void Binder::bindDouble(double const param) const
+void Connection::clearStatementCache()
 {
-    checkResult(sqlite3_bind_double(stmnt, bindPosn, param));
+    statementCache.clear();
 }
 
-void Binder::bindText(char const* param) const
+std::vector<StatementStats> Connection::statementStats() const
 {
-    checkResult(sqlite3_bind_text(stmnt, bindPosn, param, -1, SQLITE_TRANSIENT));
+    std::vector<StatementStats> all {};
+    for (sqlite3_stmt* stmnt = sqlite3_next_stmt(sqliteDb, nullptr); stmnt != nullptr;
+         stmnt = sqlite3_next_stmt(sqliteDb, stmnt)) {
+        all.push_back(StatementStats::of(stmnt));
+    }
+    return all;
 }
 
-void Binder::bindBlob(std::string const& param) const
+ConnectionStatus Connection::status(bool const resetHighwater) const
 {
-    auto const data = reinterpret_cast<const unsigned char*>(param.data());
-    auto const size = static_cast<int>(param.size());
-    checkResult(sqlite3_bind_blob(stmnt, bindPosn, &data[0], size, SQLITE_TRANSIENT));
+    auto status = [this, resetHighwater](int const op) {
+        StatusValue value {};
+        int current {};
+        int highwater {};
+        if (int const res = sqlite3_db_status(sqliteDb, op, &current, &highwater, resetHighwater)) {
+            throw std::runtime_error(std::string {"Connection::status error: "}
+                                     + sqlite3_errstr(res));
+        }
+        value.current = current;
+        value.highwater = highwater;
+        return value;
+    };
+    auto count = [&status](int const op) {
+        return static_cast<int>(status(op).current);
+    };
+    auto hits = [&status](int const op) {
+        return static_cast<int>(status(op).highwater);
+    };
+
+    ConnectionStatus snapshot {};
+    snapshot.lookasideUsed = status(SQLITE_DBSTATUS_LOOKASIDE_USED);
+    snapshot.lookasideHit = hits(SQLITE_DBSTATUS_LOOKASIDE_HIT);
+    snapshot.lookasideMissSize = hits(SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE);
+    snapshot.lookasideMissFull = hits(SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL);
+    snapshot.cacheUsed = count(SQLITE_DBSTATUS_CACHE_USED);
+    snapshot.cacheUsedShared = count(SQLITE_DBSTATUS_CACHE_USED_SHARED);
+    snapshot.cacheHit = count(SQLITE_DBSTATUS_CACHE_HIT);
+    snapshot.cacheMiss = count(SQLITE_DBSTATUS_CACHE_MISS);
+    snapshot.cacheWrite = count(SQLITE_DBSTATUS_CACHE_WRITE);
+    snapshot.cacheSpill = count(SQLITE_DBSTATUS_CACHE_SPILL);
+    snapshot.schemaUsed = count(SQLITE_DBSTATUS_SCHEMA_USED);
+    snapshot.stmtUsed = count(SQLITE_DBSTATUS_STMT_USED);
+    return snapshot;
 }
 
-void Binder::checkResult(int const res) const
+void Connection::enableProfiling()
 {
-    if (res) {
-        std::string const err {"bind fail at posn "};
-        throw std::runtime_error(err + std::to_string(bindPosn));
+    if (!profiler) {
+        profiler = std::make_unique<Profiler>();
     }
+    sqlite3_trace_v2(sqliteDb, SQLITE_TRACE_PROFILE, &Profiler::traceCallback, profiler.get());
 }
 
-//--------------------------------------------------------------------------------------------------
-
-ResultColumn::ResultColumn(sqlite3_stmt* stmnt, int const posn)
-    : stmnt {stmnt}
-    , posn {posn}
-    , type {sqlite3_column_type(stmnt, posn)}
-{}
-
-SqlColName ResultColumn::name() const
+void Connection::disableProfiling()
 {
-    return sqlite3_column_name(stmnt, posn);
+    sqlite3_trace_v2(sqliteDb, 0, nullptr, nullptr);
 }
 
-std::string ResultColumn::readText() const
+std::vector<QueryProfile> Connection::profile() const
 {
-    auto const text = reinterpret_cast<const char*>(sqlite3_column_text(stmnt, posn));
-    auto const size = static_cast<std::size_t>(sqlite3_column_bytes(stmnt, posn));
-    return {text, size};
+    return profiler ? profiler->snapshot() : std::vector<QueryProfile> {};
 }
 
-std::string ResultColumn::readBlob() const
+void Connection::resetProfile()
 {
-    auto data = static_cast<const unsigned char*>(sqlite3_column_blob(stmnt, posn));
-    auto const size = sqlite3_column_bytes(stmnt, posn);
-    return {data, data + size};
+    if (profiler) {
+        profiler->reset();
+    }
 }
 
-SqlField ResultColumn::field() const
+void Connection::resetStatementStats()
 {
-    return {name(), fieldS()};
+    for (sqlite3_stmt* stmnt = sqlite3_next_stmt(sqliteDb, nullptr); stmnt != nullptr;
+         stmnt = sqlite3_next_stmt(sqliteDb, stmnt)) {
+        (void)StatementStats::of(stmnt, true);
+    }
 }
 
-std::string ResultColumn::fieldS() const
+int Connection::lastInsertId() const
 {
-    return readText();
+    return static_cast<int>(sqlite3_last_insert_rowid(sqliteDb));
 }
 
-//--------------------------------------------------------------------------------------------------
-
-Resultset::Resultset(sqlite3_stmt* stmnt)
-    : stmnt {stmnt}
+bool Connection::getAutocommit() const
 {
-    step();
-    int const count = countColumns();
-    for (int i = 0; i < count; ++i) {
-        columns.emplace_back(stmnt, i);
-    }
+    return sqlite3_get_autocommit(sqliteDb) > 0;
 }
 
-void Resultset::step()
+void Connection::configure(ConnectionConfig const& config)
 {
-    switch (int const res {sqlite3_step(stmnt)}) {
+    static constexpr char const* journalModes[] {
+        "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"};
+    static constexpr char const* synchronousModes[] {"OFF", "NORMAL", "FULL", "EXTRA"};
+    static constexpr char const* tempStores[] {"DEFAULT", "FILE", "MEMORY"};
 
-        case SQLITE_DONE:
-            hasRow = false;
-            break;
-
-        case SQLITE_ROW:
-            hasRow = true;
-            columnPosn = 0;
-            break;
+    char const* const what {"Connection::configure error: "};
+    auto check = [what](int const res, char const* setting) {
+        if (res != SQLITE_OK) {
+            throw std::runtime_error(std::string {what} + setting + ": " + errString(res));
+        }
+    };
+    auto pragma = [&](std::string const& queryStr) {
+        forEachStatement(queryStr, what, [](sqlite3_stmt*) {}, [](sqlite3_stmt*) {});
+    };
 
-        default:
-            throw std::runtime_error(std::string {"Resultset::step error: " + std::to_string(res)});
+    if (config.lookaside) {
+        check(sqlite3_db_config(sqliteDb, SQLITE_DBCONFIG_LOOKASIDE, nullptr,
+                                config.lookaside->slotSize, config.lookaside->slotCount),
+              "lookaside");
+    }
+    if (config.pageSize) {
+        pragma("PRAGMA page_size = " + std::to_string(*config.pageSize));
+    }
+    if (config.journalMode) {
+        // sqlite keeps the old mode where the new one cannot apply (eg WAL on :memory:)
+        char const* const mode {journalModes[static_cast<int>(*config.journalMode)]};
+        std::string applied {};
+        forEachStatement(
+            std::string {"PRAGMA journal_mode = "} + mode, what, [](sqlite3_stmt*) {},
+            [&](sqlite3_stmt* stmnt) {
+                applied = fixNullStr(reinterpret_cast<char const*>(sqlite3_column_text(stmnt, 0)));
+            });
+        if (sqlite3_stricmp(applied.c_str(), mode) != 0) {
+            throw std::runtime_error(std::string {what} + "journal_mode: " + mode
+                                     + " not applied, is " + applied);
+        }
+    }
+    if (config.synchronous) {
+        pragma(std::string {"PRAGMA synchronous = "}
+               + synchronousModes[static_cast<int>(*config.synchronous)]);
+    }
+    if (config.cacheSize) {
+        pragma("PRAGMA cache_size = " + std::to_string(*config.cacheSize));
+    }
+    if (config.mmapSize) {
+        pragma("PRAGMA mmap_size = " + std::to_string(*config.mmapSize));
+    }
+    if (config.tempStore) {
+        pragma(std::string {"PRAGMA temp_store = "}
+               + tempStores[static_cast<int>(*config.tempStore)]);
+    }
+    if (config.busyTimeout) {
+        clearBusyPolicy();
+        check(sqlite3_busy_timeout(sqliteDb, static_cast<int>(config.busyTimeout->count())),
+              "busy_timeout");
+    }
+    if (config.walAutocheckpoint) {
+        check(sqlite3_wal_autocheckpoint(sqliteDb, *config.walAutocheckpoint),
+              "wal_autocheckpoint");
+    }
+    if (config.busyPolicy) {
+        setBusyPolicy(*config.busyPolicy);
+    }
+    if (config.foreignKeys) {
+        check(sqlite3_db_config(sqliteDb, SQLITE_DBCONFIG_ENABLE_FKEY,
+                                *config.foreignKeys ? 1 : 0, nullptr),
+              "foreign_keys");
     }
 }
 
-int Resultset::countColumns() const
+BlobStream Connection::openBlob(std::string const& table,
+                                std::string const& column,
+                                sqlite3_int64 const rowid,
+                                BlobAccess const access,
+                                std::string const& dbName) const
 {
-    return sqlite3_column_count(stmnt);
+    return {sqliteDb, dbName, table, column, rowid, access == BlobAccess::write};
 }
 
-int Resultset::countData() const
-{
-    return sqlite3_data_count(stmnt);
-}
+//--------------------------------------------------------------------------------------------------
 
-int Resultset::posn(SqlColName const& name) const
+void ColumnIndex::refresh(sqlite3_stmt* stmnt)
 {
-    for (auto const& column : columns) {
-        if (column.name() == name) {
-            return static_cast<int>(&column - &columns[0]);
-        }
+    int const count = sqlite3_stmt_status(stmnt, SQLITE_STMTSTATUS_REPREPARE, 0);
+    if (count == prepareCount) {
+        return;
     }
+    prepareCount = count;
 
-    throw std::runtime_error(name + " col name not found");
+    memberPositionsOf = nullptr;
+    positions.clear();
+    names.clear();
+    int const columnCount = sqlite3_column_count(stmnt);
+    names.reserve(columnCount);
+    for (int i = 0; i < columnCount; ++i) {
+        names.emplace_back(fixNullStr(sqlite3_column_name(stmnt, i)));
+    }
+    for (int i = 0; i < columnCount; ++i) {
+        positions.emplace(names[i], i);  // first of any duplicate names wins
+    }
 }
 
-SqlField Resultset::field(int const posn) const
+SqlColName const& ColumnIndex::name(int const posn) const
 {
-    if (!hasRow) {
-        return {};
-    }
-    return columns.at(posn).field();
+    return names.at(posn);
 }
 
-std::string Resultset::fieldS(int const posn) const
+std::optional<int> ColumnIndex::posn(std::string_view const name) const
 {
-    if (!hasRow) {
-        return {};
+    if (auto const found = positions.find(name); found != positions.end()) {
+        return found->second;
     }
-    return columns.at(posn).fieldS();
+    return {};
 }
 
-std::string Resultset::fieldS(std::string const& name) const
+//--------------------------------------------------------------------------------------------------
+
+ProcessStatus ProcessStatus::snapshot(bool const resetHighwater)
 {
-    return fieldS(posn(name));
+    auto status = [resetHighwater](int const op) {
+        StatusValue value {};
+        int const res = sqlite3_status64(op, &value.current, &value.highwater, resetHighwater);
+        if (res != SQLITE_OK) {
+            throw std::runtime_error(std::string {"ProcessStatus error: "} + sqlite3_errstr(res));
+        }
+        return value;
+    };
+    return {status(SQLITE_STATUS_MEMORY_USED),
+            status(SQLITE_STATUS_MALLOC_SIZE),
+            status(SQLITE_STATUS_MALLOC_COUNT),
+            status(SQLITE_STATUS_PAGECACHE_USED),
+            status(SQLITE_STATUS_PAGECACHE_OVERFLOW),
+            status(SQLITE_STATUS_PAGECACHE_SIZE),
+            status(SQLITE_STATUS_PARSER_STACK)};
 }
 
-std::string Resultset::nextFieldS()
+std::size_t cpp4sqlite::footprint(SqlTable const& table)
 {
-    return fieldS(++columnPosn);
+    auto const string = [](std::string const& str) {
+        return str.capacity() > std::string {}.capacity() ? str.capacity() + 1 : 0;
+    };
+    std::size_t bytes {table.capacity() * sizeof(SqlRow)};
+    for (auto const& row : table) {
+        bytes += row.capacity() * sizeof(SqlField);
+        for (auto const& [name, value] : row) {
+            bytes += string(name) + string(value);
+        }
+    }
+    return bytes;
 }
 
-SqlField Resultset::field(std::string const& name) const
+StatementStats StatementStats::of(sqlite3_stmt* stmnt, bool const reset)
 {
-    return columns.at(posn(name)).field();
+    auto status = [stmnt, reset](int const op) {
+        return sqlite3_stmt_status(stmnt, op, reset ? 1 : 0);
+    };
+    return {fixNullStr(sqlite3_sql(stmnt)),
+            status(SQLITE_STMTSTATUS_FULLSCAN_STEP),
+            status(SQLITE_STMTSTATUS_SORT),
+            status(SQLITE_STMTSTATUS_AUTOINDEX),
+            status(SQLITE_STMTSTATUS_VM_STEP),
+            sqlite3_stmt_status(stmnt, SQLITE_STMTSTATUS_REPREPARE, 0),  // ColumnIndex keys on it
+            status(SQLITE_STMTSTATUS_RUN),
+            status(SQLITE_STMTSTATUS_FILTER_HIT),
+            status(SQLITE_STMTSTATUS_FILTER_MISS),
+            sqlite3_stmt_status(stmnt, SQLITE_STMTSTATUS_MEMUSED, 0)};  // a size: never reset
 }
 
-SqlField Resultset::nextField()
+//--------------------------------------------------------------------------------------------------
+
+StatementCache::StatementCache(std::size_t const capacity)
+    : maxSize {capacity}
+{}
+
+StatementCache::~StatementCache()
 {
-    return field(++columnPosn);
+    for (auto const& entry : lru) {
+        sqlite3_finalize(entry.stmnt);
+    }
 }
 
-std::optional<SqlRow> Resultset::row()
+StatementCache::Lease StatementCache::acquire(sqlite3* db, std::string const& queryStr)
 {
-    if (!hasRow) {
+    if (auto const found = bySql.find(queryStr); found != bySql.end()) {
+        auto const entry = found->second;
+        if (entry->leased) {
+            ++counters.misses;
+            return {};
+        }
+        ++counters.hits;
+        entry->leased = true;
+        lru.splice(lru.begin(), lru, entry);
+        return {entry->stmnt, entry->columnIndex.get()};
+    }
+
+    ++counters.misses;
+    if (maxSize == 0) {
         return {};
     }
+    evictToCapacity(maxSize - 1);
+    if (lru.size() >= maxSize) {
+        return {};  // everything is leased
+    }
 
-    SqlRow row {};
-    int const colCount = countData();
-    for (int i {0}; i < colCount; ++i) {
-        row.push_back(field(i));
+    sqlite3_stmt* stmnt;
+    char const* data = queryStr.data();
+    int const size = static_cast<int>(queryStr.size());
+    char const* unused;
+    if (int const res = sqlite3_prepare_v3(
+            db, data, size, SQLITE_PREPARE_PERSISTENT, &stmnt, &unused)) {
+        throw std::runtime_error(std::string {"Prepare error: "} + std::to_string(res) + " : "
+                                 + sqlite3_errmsg(db));
     }
-    step();
-    return {row};
+
+    lru.push_front({queryStr, stmnt, true});
+    bySql.emplace(lru.front().queryStr, lru.begin());
+    byStmnt.emplace(stmnt, lru.begin());
+    return {stmnt, lru.front().columnIndex.get()};
 }
 
-std::optional<SqlRowS> Resultset::rowS()
+void StatementCache::release(sqlite3_stmt* stmnt)
 {
-    if (!hasRow) {
-        return {};
+    auto const found = byStmnt.find(stmnt);
+    if (found == byStmnt.end()) {
+        sqlite3_finalize(stmnt);
+        return;
     }
 
-    SqlRowS rowS {};
-    for (int i {0}; i < countData(); ++i) {
-        rowS.push_back(fieldS(i));
+    auto const entry = found->second;
+    entry->leased = false;
+    int const res = sqlite3_reset(stmnt);
+    sqlite3_clear_bindings(stmnt);
+    if ((res & 0xff) == SQLITE_SCHEMA) {
+        erase(entry);  // re-prepared on next acquire
+        return;
     }
-    step();
-    return {rowS};
+    evictToCapacity(maxSize);
 }
 
-bool Resultset::empty() const
+void StatementCache::setCapacity(std::size_t const capacity)
 {
-    return !hasRow;
+    maxSize = capacity;
+    evictToCapacity(maxSize);
 }
 
-int Resultset::toFile(std::filesystem::path const& fileSpec, FileReplace const replace) const
+std::size_t StatementCache::capacity() const
 {
-    if (exists(fileSpec) && replace != FileReplace::yes) {
-        throw std::runtime_error(std::string {"File already exists: "} + fileSpec.string());
-    }
-    std::ofstream file(fileSpec, std::ios::binary);
-    void const* blob = sqlite3_column_blob(stmnt, 0);
-    int const size = sqlite3_column_bytes(stmnt, 0);
-    file.write(static_cast<char const*>(blob), size);
-    return size;
+    return maxSize;
 }
 
-void Resultset::checkTypeCount(int const count) const
+StatementCache::Stats StatementCache::stats() const
 {
-    if (auto const colCount = countData(); colCount != count) {
-        throw std::runtime_error(count > colCount ? "too many types" : "too few types");
-    }
+    Stats res {counters};
+    res.size = lru.size();
+    return res;
 }
 
-//--------------------------------------------------------------------------------------------------
-
-PreparedStatement::PreparedStatement(sqlite3_stmt* stmnt)
-    : stmnt {stmnt}
-{}
-
-PreparedStatement::~PreparedStatement()
+void StatementCache::resetStats()
 {
-    sqlite3_finalize(stmnt);
+    counters = {};
 }
 
-//--------------------------------------------------------------------------------------------------
\ No newline at end of file
+void StatementCache::clear()
+{
+    for (auto entry = lru.begin(); entry != lru.end();) {
+        auto const next = std::next(entry);
+        if (!entry->leased) {
+            erase(entry);
+        }
+        entry = next;
+    }
+}
+
+void StatementCache::erase(Lru::iterator const entry)
+{
+    sqlite3_finalize(entry->stmnt);
+    bySql.erase(entry->queryStr);
+    byStmnt.erase(entry->stmnt);
+    lru.erase(entry);
+}
+
+void StatementCache::evictToCapacity(std::size_t const limit)
+{
+    for (auto entry = lru.end(); lru.size() > limit && entry != lru.begin();) {
+        --entry;
+        if (!entry->leased) {
+            erase(entry++);
+            ++counters.evictions;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Binder::Binder(sqlite3_stmt* stmnt)
+    : stmnt {stmnt}
+{}
+
+void Binder::reset()
+{
+    if (int const res {sqlite3_reset(stmnt)}) {
+        throw std::runtime_error(std::string {"Binder::reset error: "} + errString(res));
+    }
+    bindPosn = 0;
+}
+
+void Binder::checkBindParamCount(std::size_t const size) const
+{
+    if (std::size_t const count {static_cast<std::size_t>(sqlite3_bind_parameter_count(stmnt))};
+        size != count) {
+        throw std::runtime_error(size > count ? "too many bind params" : "too few bind params");
+    }
+}
+
+void Binder::bindInt(int const param) const
+{
+    checkResult(sqlite3_bind_int(stmnt, bindPosn, param));
+}
+
+void Binder::bindInt64(sqlite3_int64 const param) const
+{
+    checkResult(sqlite3_bind_int64(stmnt, bindPosn, param));
+}
+
+void Binder::bindDouble(double const param) const
+{
+    checkResult(sqlite3_bind_double(stmnt, bindPosn, param));
+}
+
+void Binder::bindNull() const
+{
+    checkResult(sqlite3_bind_null(stmnt, bindPosn));
+}
+
+void Binder::bindText(char const* param) const
+{
+    checkResult(sqlite3_bind_text(stmnt, bindPosn, param, -1, SQLITE_TRANSIENT));
+}
+
+void Binder::bindString(std::string_view const param) const
+{
+    if (param.find('\0') != std::string_view::npos) {
+        bindBlob(param);
+        return;
+    }
+    checkResult(sqlite3_bind_text64(
+        stmnt, bindPosn, param.data(), param.size(), SQLITE_TRANSIENT, SQLITE_UTF8));
+}
+
+void Binder::bindBlob(std::string_view const param) const
+{
+    checkResult(sqlite3_bind_blob64(stmnt, bindPosn, param.data(), param.size(), SQLITE_TRANSIENT));
+}
+
+void Binder::bindTextStatic(std::string_view const param) const
+{
+    checkResult(sqlite3_bind_text64(
+        stmnt, bindPosn, param.data(), param.size(), SQLITE_STATIC, SQLITE_UTF8));
+}
+
+void Binder::bindBlobStatic(void const* data, std::size_t const size) const
+{
+    checkResult(sqlite3_bind_blob64(stmnt, bindPosn, data, size, SQLITE_STATIC));
+}
+
+void Binder::checkResult(int const res) const
+{
+    if (res) {
+        std::string const err {"bind fail at posn "};
+        throw std::runtime_error(err + std::to_string(bindPosn));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+ResultColumn::ResultColumn(sqlite3_stmt* stmnt, int const posn, SqlColName const& name)
+    : stmnt {stmnt}
+    , posn {posn}
+    , type {sqlite3_column_type(stmnt, posn)}
+    , colName {&name}
+{}
+
+SqlColName const& ResultColumn::name() const
+{
+    return *colName;
+}
+
+void ResultColumn::refreshType()
+{
+    type = sqlite3_column_type(stmnt, posn);
+}
+
+std::string ResultColumn::readText() const
+{
+    auto const text = reinterpret_cast<const char*>(sqlite3_column_text(stmnt, posn));
+    auto const size = static_cast<std::size_t>(sqlite3_column_bytes(stmnt, posn));
+    return {text, size};
+}
+
+std::string ResultColumn::readBlob() const
+{
+    auto data = static_cast<const unsigned char*>(sqlite3_column_blob(stmnt, posn));
+    auto const size = sqlite3_column_bytes(stmnt, posn);
+    return {data, data + size};
+}
+
+SqlField ResultColumn::field() const
+{
+    return {name(), fieldS()};
+}
+
+std::string ResultColumn::fieldS() const
+{
+    return readText();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+FieldView::FieldView(sqlite3_stmt* stmnt, int const posn, SqlColName const& name)
+    : stmnt {stmnt}
+    , posn {posn}
+    , colName {&name}
+{}
+
+std::string_view FieldView::name() const
+{
+    return *colName;
+}
+
+int FieldView::type() const
+{
+    return sqlite3_column_type(stmnt, posn);
+}
+
+bool FieldView::isNull() const
+{
+    return type() == SQLITE_NULL;
+}
+
+std::string_view FieldView::text() const
+{
+    auto const text = reinterpret_cast<const char*>(sqlite3_column_text(stmnt, posn));
+    auto const size = static_cast<std::size_t>(sqlite3_column_bytes(stmnt, posn));
+    return {fixNullStr(text), size};
+}
+
+BlobView FieldView::blob() const
+{
+    auto const data = static_cast<std::byte const*>(sqlite3_column_blob(stmnt, posn));
+    auto const size = static_cast<std::size_t>(sqlite3_column_bytes(stmnt, posn));
+    return {data, size};
+}
+
+sqlite3_int64 FieldView::int64() const
+{
+    return sqlite3_column_int64(stmnt, posn);
+}
+
+double FieldView::real() const
+{
+    return sqlite3_column_double(stmnt, posn);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+RowView::RowView(sqlite3_stmt* stmnt, ColumnIndex const& columnIndex)
+    : stmnt {stmnt}
+    , columnIndex {&columnIndex}
+{}
+
+sqlite3_stmt* RowView::statement() const
+{
+    return stmnt;
+}
+
+int RowView::size() const
+{
+    return sqlite3_data_count(stmnt);
+}
+
+SqlValueRow RowView::values() const
+{
+    SqlValueRow row {};
+    int const count = size();
+    row.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        row.push_back(columnValue<SqlValue>(stmnt, i));
+    }
+    return row;
+}
+
+FieldView RowView::operator[](int const posn) const
+{
+    return {stmnt, posn, columnIndex->name(posn)};
+}
+
+FieldView RowView::operator[](std::string_view const name) const
+{
+    if (auto const posn = columnIndex->posn(name)) {
+        return (*this)[*posn];
+    }
+    throw std::runtime_error(std::string {name} + " col name not found");
+}
+
+RowView::Iterator RowView::begin() const
+{
+    return {*this, 0};
+}
+
+RowView::Iterator RowView::end() const
+{
+    return {*this, size()};
+}
+
+RowView::Iterator::Iterator(RowView const& row, int const posn)
+    : stmnt {row.stmnt}
+    , columnIndex {row.columnIndex}
+    , posn {posn}
+{}
+
+FieldView RowView::Iterator::operator*() const
+{
+    return {stmnt, posn, columnIndex->name(posn)};
+}
+
+RowView::Iterator& RowView::Iterator::operator++()
+{
+    ++posn;
+    return *this;
+}
+
+RowView::Iterator RowView::Iterator::operator++(int)
+{
+    Iterator const previous {*this};
+    ++posn;
+    return previous;
+}
+
+bool RowView::Iterator::operator==(Iterator const& other) const
+{
+    return posn == other.posn && stmnt == other.stmnt;
+}
+
+bool RowView::Iterator::operator!=(Iterator const& other) const
+{
+    return !(*this == other);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Resultset::Resultset(sqlite3_stmt* stmnt, ColumnIndex& columnIndex)
+    : stmnt {stmnt}
+    , columnIndex {&columnIndex}
+{
+    step();
+    columnIndex.refresh(stmnt);  // after step, which may re-prepare
+    int const count = countColumns();
+    columns.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        columns.emplace_back(stmnt, i, columnIndex.name(i));
+    }
+}
+
+void Resultset::step()
+{
+    int res {sqlite3_step(stmnt)};
+    if ((res == SQLITE_BUSY || res == SQLITE_LOCKED) && !hasRow) {
+        res = retryBusy(stmnt, res);
+    }
+    switch (res) {
+
+        case SQLITE_DONE:
+            hasRow = false;
+            break;
+
+        case SQLITE_ROW:
+            hasRow = true;
+            columnPosn = 0;
+            for (auto& column : columns) {
+                column.refreshType();
+            }
+            break;
+
+        default:
+            throw std::runtime_error("Resultset::step error: " + std::to_string(res) + " : "
+                                     + sqlite3_errmsg(sqlite3_db_handle(stmnt)));
+    }
+}
+
+int Resultset::countColumns() const
+{
+    return sqlite3_column_count(stmnt);
+}
+
+int Resultset::countData() const
+{
+    return sqlite3_data_count(stmnt);
+}
+
+SqlColName const& Resultset::columnName(int const posn) const
+{
+    return columnIndex->name(posn);
+}
+
+SqlColNames Resultset::columnNames() const
+{
+    SqlColNames names {};
+    int const count = countColumns();
+    names.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        names.push_back(columnName(i));
+    }
+    return names;
+}
+
+QueryResult Resultset::fetchAll()
+{
+    QueryResult result {columnNames(), {}};
+    for (RowView const& row : *this) {
+        result.rows.push_back(row.values());
+    }
+    return result;
+}
+
+int Resultset::posn(std::string_view const name) const
+{
+    if (auto const found = columnIndex->posn(name)) {
+        return *found;
+    }
+
+    throw std::runtime_error(std::string {name} + " col name not found");
+}
+
+SqlField Resultset::field(int const posn) const
+{
+    if (!hasRow) {
+        return {};
+    }
+    return columns.at(posn).field();
+}
+
+std::string Resultset::fieldS(int const posn) const
+{
+    if (!hasRow) {
+        return {};
+    }
+    return columns.at(posn).fieldS();
+}
+
+std::string Resultset::fieldS(std::string_view const name) const
+{
+    return fieldS(posn(name));
+}
+
+std::string Resultset::nextFieldS()
+{
+    return fieldS(++columnPosn);
+}
+
+SqlField Resultset::field(std::string_view const name) const
+{
+    return columns.at(posn(name)).field();
+}
+
+SqlField Resultset::nextField()
+{
+    return field(++columnPosn);
+}
+
+std::optional<SqlRow> Resultset::row()
+{
+    settle();
+    if (!hasRow) {
+        return {};
+    }
+
+    SqlRow row {};
+    int const colCount = countData();
+    for (int i {0}; i < colCount; ++i) {
+        row.push_back(field(i));
+    }
+    step();
+    return {row};
+}
+
+std::optional<SqlRowS> Resultset::rowS()
+{
+    settle();
+    if (!hasRow) {
+        return {};
+    }
+
+    SqlRowS rowS {};
+    for (int i {0}; i < countData(); ++i) {
+        rowS.push_back(fieldS(i));
+    }
+    step();
+    return {rowS};
+}
+
+std::optional<RowView> Resultset::rowView()
+{
+    settle();
+    if (!hasRow) {
+        return {};
+    }
+    advancePending = true;
+    return RowView {stmnt, *columnIndex};
+}
+
+void Resultset::settle()
+{
+    if (advancePending) {
+        advancePending = false;
+        step();
+    }
+}
+
+namespace
+{
+/**
+ * From the current row's value, else the declared type per sqlite's affinity rules
+ */
+ColumnBuffer::Kind inferKind(sqlite3_stmt* stmnt, int const posn)
+{
+    switch (sqlite3_column_type(stmnt, posn)) {
+        case SQLITE_INTEGER:
+            return ColumnBuffer::Kind::int64;
+        case SQLITE_FLOAT:
+            return ColumnBuffer::Kind::real;
+        case SQLITE_NULL:
+            break;
+        default:
+            return ColumnBuffer::Kind::text;
+    }
+
+    std::string declType {fixNullStr(sqlite3_column_decltype(stmnt, posn))};
+    std::transform(declType.begin(), declType.end(), declType.begin(), [](unsigned char c) {
+        return static_cast<char>(std::toupper(c));
+    });
+    auto const has = [&declType](char const* str) {
+        return declType.find(str) != std::string::npos;
+    };
+    if (has("INT")) {
+        return ColumnBuffer::Kind::int64;
+    }
+    if (has("CHAR") || has("CLOB") || has("TEXT") || has("BLOB") || declType.empty()) {
+        return ColumnBuffer::Kind::text;
+    }
+    return ColumnBuffer::Kind::real;  // REAL, FLOA, DOUB, NUMERIC
+}
+}  // namespace
+
+void ColumnBuffer::clear()
+{
+    ints.clear();
+    reals.clear();
+    offsets.assign(1, 0);
+    arena.clear();
+    validity.clear();
+}
+
+std::size_t Resultset::fetchColumns(ColumnBatch& batch, std::size_t const batchSize)
+{
+    if (batchSize == 0) {
+        throw std::runtime_error("Resultset::fetchColumns: batchSize must be at least 1");
+    }
+    settle();
+    batch.rows = 0;
+    if (!hasRow) {
+        for (auto& column : batch.columns) {
+            column.clear();
+        }
+        return 0;
+    }
+
+    int const count = countColumns();
+    if (batch.columns.size() != static_cast<std::size_t>(count)) {
+        batch.columns.assign(count, {});
+        for (int i = 0; i < count; ++i) {
+            batch.columns[i].kind = inferKind(stmnt, i);
+        }
+    }
+
+    for (auto& column : batch.columns) {
+        column.clear();
+        column.validity.reserve((batchSize + 7) / 8);
+        if (column.kind == ColumnBuffer::Kind::int64) {
+            column.ints.reserve(batchSize);
+        }
+        else if (column.kind == ColumnBuffer::Kind::real) {
+            column.reals.reserve(batchSize);
+        }
+        else {
+            column.offsets.reserve(batchSize + 1);
+        }
+    }
+
+    constexpr std::size_t maxArenaSize {std::numeric_limits<std::uint32_t>::max()};  // offsets
+    std::size_t row {0};
+    for (; row < batchSize && hasRow; ++row) {
+        for (int i = 0; i < count; ++i) {
+            auto& column = batch.columns[i];
+            if (row % 8 == 0) {
+                column.validity.push_back(0);
+            }
+            bool const notNull = sqlite3_column_type(stmnt, i) != SQLITE_NULL;
+            column.validity.back() |= static_cast<std::uint8_t>(notNull << (row % 8));
+
+            switch (column.kind) {
+                case ColumnBuffer::Kind::int64:
+                    column.ints.push_back(sqlite3_column_int64(stmnt, i));
+                    break;
+
+                case ColumnBuffer::Kind::real:
+                    column.reals.push_back(sqlite3_column_double(stmnt, i));
+                    break;
+
+                case ColumnBuffer::Kind::text: {
+                    auto const text = columnValue<std::string_view>(stmnt, i);
+                    if (text.size() > maxArenaSize - column.arena.size()) {
+                        throw std::runtime_error("Resultset::fetchColumns: arena passes 4 GiB");
+                    }
+                    column.arena.append(text);
+                    column.offsets.push_back(static_cast<std::uint32_t>(column.arena.size()));
+                    break;
+                }
+            }
+        }
+        step();
+    }
+    batch.rows = row;
+    return row;
+}
+
+ColumnBatch Resultset::fetchColumns(std::size_t const batchSize)
+{
+    ColumnBatch batch {};
+    fetchColumns(batch, batchSize);
+    return batch;
+}
+
+bool Resultset::empty() const
+{
+    return !hasRow;
+}
+
+int Resultset::toFile(std::filesystem::path const& fileSpec, FileReplace const replace) const
+{
+    if (exists(fileSpec) && replace != FileReplace::yes) {
+        throw std::runtime_error(std::string {"File already exists: "} + fileSpec.string());
+    }
+    std::ofstream file(fileSpec, std::ios::binary);
+    void const* blob = sqlite3_column_blob(stmnt, 0);
+    int const size = sqlite3_column_bytes(stmnt, 0);
+    file.write(static_cast<char const*>(blob), size);
+    return size;
+}
+
+void Resultset::checkTypeCount(int const count) const
+{
+    checkTypeCount(count, countData());
+}
+
+void Resultset::checkTypeCount(int const count, int const colCount)
+{
+    if (colCount != count) {
+        throw std::runtime_error(count > colCount ? "too many types" : "too few types");
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Resultset::Iterator::Iterator(Resultset* resultset)
+    : resultset {resultset}
+{}
+
+RowView Resultset::Iterator::operator*() const
+{
+    return {resultset->stmnt, *resultset->columnIndex};
+}
+
+Resultset::Iterator& Resultset::Iterator::operator++()
+{
+    resultset->step();
+    return *this;
+}
+
+void Resultset::Iterator::operator++(int)
+{
+    resultset->step();
+}
+
+bool Resultset::Iterator::operator==(Iterator const& other) const
+{
+    return atEnd() == other.atEnd();
+}
+
+bool Resultset::Iterator::operator!=(Iterator const& other) const
+{
+    return !(*this == other);
+}
+
+bool Resultset::Iterator::atEnd() const
+{
+    return resultset == nullptr || !resultset->hasRow;
+}
+
+Resultset::Iterator Resultset::begin()
+{
+    settle();
+    return Iterator {this};
+}
+
+Resultset::Iterator Resultset::end()
+{
+    return Iterator {};
+}
+
+//--------------------------------------------------------------------------------------------------
+
+PreparedStatement::PreparedStatement(sqlite3_stmt* stmnt)
+    : stmnt {stmnt}
+    , ownedIndex {std::make_unique<ColumnIndex>()}
+    , columnIndex {ownedIndex.get()}
+{}
+
+PreparedStatement::PreparedStatement(StatementCache::Lease const lease, StatementCache* cache)
+    : stmnt {lease.stmnt}
+    , cache {cache}
+    , columnIndex {lease.columnIndex}
+{}
+
+PreparedStatement::PreparedStatement(PreparedStatement&& other) noexcept
+    : stmnt {std::exchange(other.stmnt, nullptr)}
+    , cache {std::exchange(other.cache, nullptr)}
+    , ownedIndex {std::move(other.ownedIndex)}
+    , columnIndex {std::exchange(other.columnIndex, nullptr)}
+{}
+
+PreparedStatement::~PreparedStatement()
+{
+    if (cache != nullptr) {
+        cache->release(stmnt);
+    }
+    else {
+        sqlite3_finalize(stmnt);
+    }
+}
+
+StatementStats PreparedStatement::stats() const
+{
+    return StatementStats::of(stmnt);
+}
+
+void PreparedStatement::resetStats()
+{
+    (void)StatementStats::of(stmnt, true);
+}
+
+PreparedStatement::Batch::Batch(sqlite3_stmt* stmnt, std::size_t const commitInterval)
+    : stmnt {stmnt}
+    , db {sqlite3_db_handle(stmnt)}
+    , commitInterval {commitInterval}
+{}
+
+PreparedStatement::Batch::~Batch()
+{
+    sqlite3_reset(stmnt);
+    if (ownsTransaction) {
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+    }
+    sqlite3_finalize(begin);
+    sqlite3_finalize(commitStmnt);
+}
+
+void PreparedStatement::Batch::step()
+{
+    if (pending == 0 && sqlite3_get_autocommit(db)) {
+        exec(begin, "BEGIN");
+        ownsTransaction = true;
+    }
+
+    int res {sqlite3_step(stmnt)};
+    if (res == SQLITE_BUSY || res == SQLITE_LOCKED) {
+        res = retryBusy(stmnt, res);
+    }
+    while (res == SQLITE_ROW) {
+        res = sqlite3_step(stmnt);
+    }
+    if (res != SQLITE_DONE) {
+        throw std::runtime_error(std::string {"executeMany step error: "} + std::to_string(res)
+                                 + " : " + sqlite3_errmsg(db));
+    }
+    changeCount += static_cast<std::size_t>(sqlite3_changes(db));
+
+    if (++pending == commitInterval) {
+        commit();
+    }
+}
+
+void PreparedStatement::Batch::commit()
+{
+    if (ownsTransaction) {
+        sqlite3_reset(stmnt);
+        exec(commitStmnt, "COMMIT");
+        ownsTransaction = false;
+    }
+    pending = 0;
+}
+
+std::size_t PreparedStatement::Batch::changes() const
+{
+    return changeCount;
+}
+
+void PreparedStatement::Batch::exec(sqlite3_stmt*& control, char const* const sql) const
+{
+    // prepared rather than sqlite3_exec, so a busy COMMIT can be rerun
+    int res {SQLITE_OK};
+    if (control == nullptr) {
+        res = sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &control, nullptr);
+    }
+    if (res == SQLITE_OK) {
+        res = sqlite3_step(control);
+        if (res == SQLITE_BUSY || res == SQLITE_LOCKED) {
+            res = retryBusy(control, res);
+        }
+    }
+    if (res != SQLITE_OK && res != SQLITE_DONE) {
+        std::string const msg {sqlite3_errmsg(db)};
+        sqlite3_reset(control);
+        throw std::runtime_error(std::string {"executeMany "} + sql + " error: " + msg);
+    }
+    sqlite3_reset(control);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Transaction::Transaction(Connection& connection, TransactionMode const mode)
+    : connection {&connection}
+{
+    switch (mode) {
+        case TransactionMode::deferred:
+            connection.execCached("BEGIN DEFERRED");
+            break;
+        case TransactionMode::immediate:
+            connection.execCached("BEGIN IMMEDIATE");
+            break;
+        case TransactionMode::exclusive:
+            connection.execCached("BEGIN EXCLUSIVE");
+            break;
+    }
+}
+
+Transaction::Transaction(Transaction&& other) noexcept
+    : connection {std::exchange(other.connection, nullptr)}
+{}
+
+Transaction::~Transaction()
+{
+    try {
+        rollback();
+    }
+    catch (...) {
+        // nothing more can be done here; sqlite rolls back on close
+    }
+}
+
+void Transaction::commit()
+{
+    if (connection != nullptr) {
+        connection->execCached("COMMIT");
+        connection = nullptr;
+    }
+}
+
+void Transaction::rollback()
+{
+    if (connection != nullptr) {
+        // sqlite may already have rolled back on error, see Connection::getAutocommit()
+        if (!connection->getAutocommit()) {
+            connection->execCached("ROLLBACK");
+        }
+        connection = nullptr;
+    }
+}
+
+bool Transaction::active() const
+{
+    return connection != nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+Savepoint::Savepoint(Connection& connection)
+    : connection {&connection}
+    , name {"cpp4sqlite_sp" + std::to_string(connection.savepointDepth)}
+{
+    connection.execCached("SAVEPOINT " + name);
+    ++connection.savepointDepth;
+}
+
+Savepoint::Savepoint(Savepoint&& other) noexcept
+    : connection {std::exchange(other.connection, nullptr)}
+    , name {std::move(other.name)}
+{}
+
+Savepoint::~Savepoint()
+{
+    try {
+        rollback();
+    }
+    catch (...) {
+        // nothing more can be done here
+    }
+}
+
+void Savepoint::release()
+{
+    if (connection != nullptr) {
+        connection->execCached("RELEASE " + name);
+        end();
+    }
+}
+
+void Savepoint::rollback()
+{
+    if (connection != nullptr) {
+        Connection* const conn = connection;
+        end();
+        if (!conn->getAutocommit()) {
+            conn->execCached("ROLLBACK TO " + name);
+            conn->execCached("RELEASE " + name);
+        }
+    }
+}
+
+bool Savepoint::active() const
+{
+    return connection != nullptr;
+}
+
+void Savepoint::end()
+{
+    --connection->savepointDepth;
+    connection = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+BlobStream::BlobStream(sqlite3* db,
+                       std::string const& dbName,
+                       std::string const& table,
+                       std::string const& column,
+                       sqlite3_int64 const rowid,
+                       bool const writable)
+{
+    if (int const res = sqlite3_blob_open(
+            db, dbName.c_str(), table.c_str(), column.c_str(), rowid, writable ? 1 : 0, &blob)) {
+        sqlite3_blob_close(blob);
+        throw std::runtime_error(std::string {"BlobStream open error: "} + std::to_string(res)
+                                 + " : " + sqlite3_errmsg(db));
+    }
+}
+
+BlobStream::BlobStream(BlobStream&& other) noexcept
+    : blob {std::exchange(other.blob, nullptr)}
+{}
+
+BlobStream::~BlobStream()
+{
+    sqlite3_blob_close(blob);
+}
+
+std::size_t BlobStream::size() const
+{
+    return static_cast<std::size_t>(sqlite3_blob_bytes(blob));
+}
+
+void BlobStream::write(void const* data, std::size_t const count, std::size_t const offset)
+{
+    checkResult(sqlite3_blob_write(blob, data, static_cast<int>(count), static_cast<int>(offset)),
+                "write");
+}
+
+void BlobStream::read(void* data, std::size_t const count, std::size_t const offset) const
+{
+    checkResult(sqlite3_blob_read(blob, data, static_cast<int>(count), static_cast<int>(offset)),
+                "read");
+}
+
+std::size_t BlobStream::writeFrom(std::istream& source, std::size_t const chunkSize)
+{
+    std::vector<char> buffer(chunkSize);
+    std::size_t const total = size();
+    std::size_t offset {0};
+    while (offset < total && source) {
+        auto const wanted = std::min(chunkSize, total - offset);
+        source.read(buffer.data(), static_cast<std::streamsize>(wanted));
+        auto const count = static_cast<std::size_t>(source.gcount());
+        if (count == 0) {
+            break;
+        }
+        write(buffer.data(), count, offset);
+        offset += count;
+    }
+    return offset;
+}
+
+std::size_t BlobStream::writeFrom(std::filesystem::path const& fileSpec,
+                                  std::size_t const chunkSize)
+{
+    std::ifstream stream {fileSpec, std::ios::binary};
+    if (!stream) {
+        throw std::runtime_error(std::string {"Invalid filePath: "} + fileSpec.string());
+    }
+    return writeFrom(stream, chunkSize);
+}
+
+#ifndef _WIN32
+std::size_t BlobStream::writeFrom(int const fd, std::size_t const chunkSize)
+{
+    std::vector<char> buffer(chunkSize);
+    std::size_t const total = size();
+    std::size_t offset {0};
+    while (offset < total) {
+        ssize_t const count = ::read(fd, buffer.data(), std::min(chunkSize, total - offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            throw std::runtime_error(std::string {"BlobStream read fd error: "}
+                                     + std::strerror(errno));
+        }
+        if (count == 0) {
+            break;
+        }
+        write(buffer.data(), static_cast<std::size_t>(count), offset);
+        offset += static_cast<std::size_t>(count);
+    }
+    return offset;
+}
+#endif
+
+std::size_t BlobStream::readTo(std::ostream& sink, std::size_t const chunkSize) const
+{
+    std::vector<char> buffer(chunkSize);
+    std::size_t const total = size();
+    std::size_t offset {0};
+    while (offset < total) {
+        std::size_t const count = std::min(chunkSize, total - offset);
+        read(buffer.data(), count, offset);
+        sink.write(buffer.data(), static_cast<std::streamsize>(count));
+        offset += count;
+    }
+    return offset;
+}
+
+void BlobStream::reopen(sqlite3_int64 const rowid)
+{
+    checkResult(sqlite3_blob_reopen(blob, rowid), "reopen");
+}
+
+void BlobStream::checkResult(int const res, char const* what) const
+{
+    if (res) {
+        throw std::runtime_error(std::string {"BlobStream "} + what + " error: " + errString(res));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
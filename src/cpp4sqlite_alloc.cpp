@@ -0,0 +1,343 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include "cpp4sqlite_alloc.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+/**
+ * Precedes each block: its size class (or large) and usable size. Keeps the block 8-aligned.
+ */
+struct BlockHeader
+{
+    static constexpr std::uint32_t large {0xffffffff};
+
+    std::uint32_t sizeClass;
+    std::uint32_t size;
+};
+static_assert(sizeof(BlockHeader) == 8);
+
+BlockHeader* headerOf(void* block)
+{
+    return static_cast<BlockHeader*>(block) - 1;
+}
+
+void* systemAllocate(std::uint32_t const sizeClass, std::uint32_t const size)
+{
+    auto* const header = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + size));
+    if (header == nullptr) {
+        return nullptr;
+    }
+    *header = {sizeClass, size};
+    return header + 1;
+}
+
+void systemFree(void* block)
+{
+    std::free(headerOf(block));
+}
+
+std::atomic<std::uint64_t> nextGeneration {1};
+
+/**
+ * Per thread free lists of pooled blocks. Blocks are individually malloc'd, so may be freed
+ * whichever pool they came from.
+ */
+struct ThreadCache
+{
+    std::uint64_t generation {0};
+    std::vector<std::vector<void*>> lists {};
+
+    ~ThreadCache()
+    {
+        flush();
+    }
+
+    std::vector<void*>& list(std::uint64_t const poolGeneration, int const sizeClass)
+    {
+        if (generation != poolGeneration) {
+            flush();
+            generation = poolGeneration;
+            lists.resize(PoolAllocator::classCount);
+        }
+        return lists[sizeClass];
+    }
+
+    void flush()
+    {
+        for (auto& blocks : lists) {
+            for (void* block : blocks) {
+                systemFree(block);
+            }
+            blocks.clear();
+        }
+    }
+};
+
+thread_local ThreadCache threadCache {};
+
+// sqlite3_mem_methods has no context for xMalloc etc, so the installed allocator is global
+Allocator* installed {};
+std::atomic<bool> guardActive {false};
+
+void* xMalloc(int const size)
+{
+    return installed->allocate(size);
+}
+
+void xFree(void* block)
+{
+    installed->deallocate(block);
+}
+
+void* xRealloc(void* block, int const size)
+{
+    return installed->reallocate(block, size);
+}
+
+int xSize(void* block)
+{
+    return installed->size(block);
+}
+
+int xRoundup(int const size)
+{
+    return installed->roundup(size);
+}
+
+int xInit(void*)
+{
+    return SQLITE_OK;
+}
+
+void xShutdown(void*)
+{}
+
+void checkConfig(int const res, char const* what)
+{
+    if (res != SQLITE_OK) {
+        throw std::runtime_error(std::string {"SqliteInit: "} + what + " error: " + errString(res));
+    }
+}
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+
+int Allocator::roundup(int const size)
+{
+    return (size + 7) & ~7;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int PoolAllocator::sizeClass(int const size)
+{
+    if (size <= 128) {
+        return size <= 16 ? 0 : (size + 15) / 16 - 1;
+    }
+    if (size > maxPooled) {
+        return -1;
+    }
+    int group {0};
+    while ((128 << (group + 1)) < size) {
+        ++group;
+    }
+    int const base {128 << group};
+    int const step {base / 4};
+    return 8 + 4 * group + (size - base + step - 1) / step - 1;
+}
+
+int PoolAllocator::classSize(int const sizeClass)
+{
+    if (sizeClass < 8) {
+        return (sizeClass + 1) * 16;
+    }
+    int const group {(sizeClass - 8) / 4};
+    int const base {128 << group};
+    return base + ((sizeClass - 8) % 4 + 1) * (base / 4);
+}
+
+PoolAllocator::PoolAllocator()
+    : depots {std::make_unique<Depot[]>(classCount)}
+    , generation {nextGeneration.fetch_add(1)}
+{}
+
+PoolAllocator::~PoolAllocator()
+{
+    for (int i = 0; i < classCount; ++i) {
+        for (void* block : depots[i].blocks) {
+            systemFree(block);
+        }
+    }
+}
+
+void* PoolAllocator::allocate(int const size)
+{
+    int const sizeClass {PoolAllocator::sizeClass(size)};
+    if (sizeClass < 0) {
+        largeAllocs.fetch_add(1, std::memory_order_relaxed);
+        return systemAllocate(BlockHeader::large, static_cast<std::uint32_t>(roundup(size)));
+    }
+
+    auto& cache = threadCache.list(generation, sizeClass);
+    if (cache.empty()) {
+        refill(sizeClass, cache);
+    }
+    if (cache.empty()) {
+        systemAllocs.fetch_add(1, std::memory_order_relaxed);
+        return systemAllocate(sizeClass, classSize(sizeClass));
+    }
+    void* const block = cache.back();
+    cache.pop_back();
+    return block;
+}
+
+void PoolAllocator::deallocate(void* block)
+{
+    if (block == nullptr) {
+        return;
+    }
+    auto const sizeClass = headerOf(block)->sizeClass;
+    if (sizeClass == BlockHeader::large) {
+        systemFree(block);
+        return;
+    }
+
+    auto& cache = threadCache.list(generation, static_cast<int>(sizeClass));
+    cache.push_back(block);
+    if (cache.size() >= 2 * batchSize) {
+        spill(static_cast<int>(sizeClass), cache);
+    }
+}
+
+void* PoolAllocator::reallocate(void* block, int const size)
+{
+    if (block == nullptr) {
+        return allocate(size);
+    }
+    int const current {this->size(block)};
+    if (size <= current && roundup(size) == current) {
+        return block;
+    }
+    void* const moved = allocate(size);
+    if (moved != nullptr) {
+        std::memcpy(moved, block, static_cast<std::size_t>(std::min(size, current)));
+        deallocate(block);
+    }
+    return moved;
+}
+
+int PoolAllocator::size(void* block)
+{
+    return block == nullptr ? 0 : static_cast<int>(headerOf(block)->size);
+}
+
+int PoolAllocator::roundup(int const size)
+{
+    int const sizeClass {PoolAllocator::sizeClass(size)};
+    return sizeClass < 0 ? Allocator::roundup(size) : classSize(sizeClass);
+}
+
+void PoolAllocator::refill(int const sizeClass, std::vector<void*>& cache)
+{
+    Depot& depot = depots[sizeClass];
+    std::lock_guard lock {depot.mutex};
+    if (depot.blocks.empty()) {
+        return;
+    }
+    auto const count = std::min(batchSize, depot.blocks.size());
+    cache.insert(cache.end(), depot.blocks.end() - static_cast<std::ptrdiff_t>(count),
+                 depot.blocks.end());
+    depot.blocks.resize(depot.blocks.size() - count);
+    refills.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PoolAllocator::spill(int const sizeClass, std::vector<void*>& cache)
+{
+    Depot& depot = depots[sizeClass];
+    std::lock_guard lock {depot.mutex};
+    depot.blocks.insert(depot.blocks.end(), cache.end() - batchSize, cache.end());
+    cache.resize(cache.size() - batchSize);
+    spills.fetch_add(1, std::memory_order_relaxed);
+}
+
+PoolAllocator::Stats PoolAllocator::stats() const
+{
+    return {refills.load(std::memory_order_relaxed),
+            spills.load(std::memory_order_relaxed),
+            systemAllocs.load(std::memory_order_relaxed),
+            largeAllocs.load(std::memory_order_relaxed)};
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SqliteInit::SqliteInit(Allocator& allocator)
+{
+    install([&allocator] {
+        installed = &allocator;
+        static sqlite3_mem_methods const methods {
+            xMalloc, xFree, xRealloc, xSize, xRoundup, xInit, xShutdown, nullptr};
+        checkConfig(sqlite3_config(SQLITE_CONFIG_MALLOC, &methods), "SQLITE_CONFIG_MALLOC");
+    });
+}
+
+SqliteInit::SqliteInit(Heap const heap)
+{
+    if (!heapSupported()) {
+        throw std::runtime_error(
+            "SqliteInit: SQLITE_CONFIG_HEAP needs sqlite built with SQLITE_ENABLE_MEMSYS5");
+    }
+    install([&heap] {
+        int const res {sqlite3_config(
+            SQLITE_CONFIG_HEAP, heap.buffer, heap.size, heap.minAllocation)};
+        checkConfig(res, "SQLITE_CONFIG_HEAP");
+    });
+}
+
+SqliteInit::~SqliteInit()
+{
+    restore();
+}
+
+template<typename Configure>
+void SqliteInit::install(Configure configure)
+{
+    if (guardActive.exchange(true)) {
+        throw std::runtime_error("SqliteInit: a guard already exists");
+    }
+    sqlite3_shutdown();
+    sqlite3_config(SQLITE_CONFIG_GETMALLOC, &previous);
+    try {
+        configure();
+        checkConfig(sqlite3_initialize(), "initialize");
+    }
+    catch (...) {
+        restore();
+        throw;
+    }
+}
+
+void SqliteInit::restore()
+{
+    sqlite3_shutdown();
+    sqlite3_config(SQLITE_CONFIG_MALLOC, &previous);
+    installed = nullptr;
+    guardActive = false;
+}
+
+bool SqliteInit::heapSupported()
+{
+    return sqlite3_compileoption_used("ENABLE_MEMSYS5") != 0;
+}
+
+//--------------------------------------------------------------------------------------------------
@@ -0,0 +1,99 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include "cpp4sqlite_async.h"
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+AsyncConnection::AsyncConnection(std::string_view const name,
+                                 OpenOption const option,
+                                 std::size_t const queueDepth)
+    : connection {name, option | OpenOption::NOMUTEX}
+    , ring(std::max<std::size_t>(queueDepth, 1))
+    , worker {[this] {
+        run();
+    }}
+{}
+
+AsyncConnection::~AsyncConnection()
+{
+    {
+        std::lock_guard lock {mutex};
+        stopping = true;
+    }
+    notEmpty.notify_one();
+    notFull.notify_all();
+    worker.join();
+}
+
+std::future<std::vector<QueryResult>> AsyncConnection::executeScript(std::string queryStr)
+{
+    return submit([queryStr = std::move(queryStr)](Connection& conn) {
+        return conn.executeScript(queryStr);
+    });
+}
+
+std::size_t AsyncConnection::queueDepth() const
+{
+    return ring.size();
+}
+
+std::size_t AsyncConnection::pending() const
+{
+    std::lock_guard lock {mutex};
+    return count;
+}
+
+bool AsyncConnection::enqueue(std::unique_ptr<Job> job, bool const wait)
+{
+    {
+        std::unique_lock lock {mutex};
+        if (wait) {
+            if (count == ring.size() && std::this_thread::get_id() == worker.get_id()) {
+                // work submitting more work: waiting for itself to drain the queue never ends
+                throw std::runtime_error("AsyncConnection: queue full on submit from worker");
+            }
+            notFull.wait(lock, [this] {
+                return stopping || count < ring.size();
+            });
+        }
+        if (stopping) {
+            throw std::runtime_error("AsyncConnection: submit after shutdown");
+        }
+        if (count == ring.size()) {
+            return false;
+        }
+        ring[(head + count) % ring.size()] = std::move(job);
+        ++count;
+    }
+    notEmpty.notify_one();
+    return true;
+}
+
+void AsyncConnection::run()
+{
+    for (;;) {
+        std::unique_ptr<Job> job {};
+        {
+            std::unique_lock lock {mutex};
+            notEmpty.wait(lock, [this] {
+                return stopping || count != 0;
+            });
+            if (count == 0) {
+                return;  // stopping and drained
+            }
+            job = std::move(ring[head]);
+            head = (head + 1) % ring.size();
+            --count;
+        }
+        notFull.notify_one();
+        job->run(connection);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
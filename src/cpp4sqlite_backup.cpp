@@ -0,0 +1,138 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include "cpp4sqlite_backup.h"
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+Backup::Backup(Connection& source, std::string const& destinationPath)
+    : Backup(source, destinationPath, Options {})
+{}
+
+Backup::Backup(Connection& source, std::string const& destinationPath, Options options)
+    : source {source}
+    , destination {destinationPath, OpenOption::CREATERW}
+    , options {std::move(options)}
+{}
+
+Backup::~Backup()
+{
+    cancel();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool Backup::run(OnProgress const& onProgress)
+{
+    {
+        std::lock_guard lock {mutex};
+        cancelRequested = false;
+    }
+    return copy(onProgress);
+}
+
+bool Backup::copy(OnProgress const& onProgress)
+{
+    std::unique_ptr<sqlite3_backup, decltype(&sqlite3_backup_finish)> const backup {
+        sqlite3_backup_init(destination.sqliteDb, options.destinationName.c_str(),
+                            source.sqliteDb, options.sourceName.c_str()),
+        &sqlite3_backup_finish};
+    if (backup == nullptr) {
+        throw std::runtime_error(std::string {"Backup error: "}
+                                 + sqlite3_errmsg(destination.sqliteDb));
+    }
+
+    while (true) {
+        int const res {sqlite3_backup_step(backup.get(), options.pagesPerStep)};
+        remaining = sqlite3_backup_remaining(backup.get());
+        total = sqlite3_backup_pagecount(backup.get());
+        ++steps;
+        if (onProgress) {
+            onProgress(progress());
+        }
+
+        if (res == SQLITE_DONE) {
+            return true;
+        }
+        if (res != SQLITE_OK && res != SQLITE_BUSY && res != SQLITE_LOCKED) {
+            throw std::runtime_error("Backup error: " + errString(res));
+        }
+        std::unique_lock lock {mutex};
+        if (cancelled.wait_for(lock, options.pause, [this] {
+                return cancelRequested;
+            })) {
+            return false;
+        }
+    }
+}
+
+void Backup::start(OnProgress onProgress)
+{
+    if (worker.joinable()) {
+        throw std::runtime_error("Backup: already started");
+    }
+    {
+        // here rather than on the thread, so a cancel() straight after start() is kept
+        std::lock_guard lock {mutex};
+        cancelRequested = false;
+        completed = false;
+        error = nullptr;
+    }
+    worker = std::thread {[this, onProgress = std::move(onProgress)] {
+        try {
+            bool const done {copy(onProgress)};
+            std::lock_guard lock {mutex};
+            completed = done;
+        }
+        catch (...) {
+            std::lock_guard lock {mutex};
+            error = std::current_exception();
+        }
+    }};
+}
+
+bool Backup::wait()
+{
+    if (worker.joinable()) {
+        worker.join();
+    }
+    std::lock_guard lock {mutex};
+    if (error) {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+    return completed;
+}
+
+void Backup::cancel()
+{
+    {
+        std::lock_guard lock {mutex};
+        cancelRequested = true;
+    }
+    cancelled.notify_all();
+}
+
+Backup::Progress Backup::progress() const
+{
+    return {remaining.load(), total.load(), steps.load()};
+}
+
+void Backup::vacuumInto(Connection& source,
+                        std::string const& destinationPath,
+                        std::string const& sourceName)
+{
+    // the schema name is an identifier, so cannot be bound
+    std::string escaped {};
+    for (char const c : sourceName) {
+        escaped += c == '"' ? "\"\"" : std::string(1, c);
+    }
+    (void)source.prepare("VACUUM \"" + escaped + "\" INTO ?").execute(destinationPath);
+}
+
+//--------------------------------------------------------------------------------------------------
@@ -0,0 +1,185 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include "cpp4sqlite_checkpoint.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+constexpr int defaultAutocheckpoint {1000};  // SQLITE_DEFAULT_WAL_AUTOCHECKPOINT
+
+ConnectionConfig checkpointerConfig(CheckpointScheduler::Thresholds const& thresholds)
+{
+    ConnectionConfig config {};
+    config.busyTimeout = thresholds.busyTimeout;
+    return config;
+}
+}  // namespace
+
+CheckpointScheduler::CheckpointScheduler(std::string const& path)
+    : CheckpointScheduler(path, Thresholds {})
+{}
+
+CheckpointScheduler::CheckpointScheduler(std::string const& path, Thresholds const thresholds)
+    : walPath {path + "-wal"}
+    , thresholds {thresholds}
+    , connection {path, OpenOption::READWRITE | OpenOption::NOMUTEX,
+                  checkpointerConfig(thresholds)}
+    , worker {[this] {
+        run();
+    }}
+{}
+
+// sqlite calls the hook holding the connection's mutex, and the hook takes ours: so sqlite is
+// never called with ours held
+
+CheckpointScheduler::~CheckpointScheduler()
+{
+    std::vector<sqlite3*> writers {};
+    {
+        std::lock_guard lock {mutex};
+        writers.swap(watched);
+        stopping = true;
+    }
+    for (sqlite3* const db : writers) {
+        sqlite3_wal_autocheckpoint(db, defaultAutocheckpoint);
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void CheckpointScheduler::watch(Connection& writer)
+{
+    {
+        std::lock_guard lock {mutex};
+        watched.push_back(writer.sqliteDb);
+    }
+    sqlite3_wal_hook(writer.sqliteDb, walHook, this);
+}
+
+void CheckpointScheduler::unwatch(Connection& writer)
+{
+    {
+        std::lock_guard lock {mutex};
+        auto const found = std::find(watched.begin(), watched.end(), writer.sqliteDb);
+        if (found == watched.end()) {
+            return;
+        }
+        watched.erase(found);
+    }
+    sqlite3_wal_autocheckpoint(writer.sqliteDb, defaultAutocheckpoint);
+}
+
+CheckpointScheduler::Stats CheckpointScheduler::stats() const
+{
+    Stats stats {};
+    {
+        std::lock_guard lock {mutex};
+        stats = counters;
+    }
+    std::error_code error {};
+    auto const bytes = std::filesystem::file_size(walPath, error);
+    stats.walFileBytes = error ? 0 : bytes;
+    return stats;
+}
+
+/**
+ * On the committing thread, with its connection's mutex held: record and wake, nothing more.
+ * Only main is checkpointed, so commits to attached WAL databases are ignored
+ */
+int CheckpointScheduler::walHook(void* scheduler,
+                                 sqlite3*,
+                                 char const* const dbName,
+                                 int const pages)
+{
+    if (std::strcmp(dbName, "main") != 0) {
+        return SQLITE_OK;
+    }
+    auto& self = *static_cast<CheckpointScheduler*>(scheduler);
+    {
+        std::lock_guard lock {self.mutex};
+        self.counters.walPages = pages;
+        ++self.counters.commits;
+        if (pages < self.thresholds.passivePages) {
+            return SQLITE_OK;
+        }
+        self.pending = true;
+    }
+    self.wake.notify_one();
+    return SQLITE_OK;
+}
+
+void CheckpointScheduler::run()
+{
+    std::unique_lock lock {mutex};
+    while (true) {
+        wake.wait(lock, [this] {
+            return stopping || pending;
+        });
+        if (stopping) {
+            return;
+        }
+        pending = false;
+        int const pages {counters.walPages};
+        lock.unlock();
+        checkpoint(pages);
+        lock.lock();
+    }
+}
+
+void CheckpointScheduler::checkpoint(int const pages)
+{
+    int mode {SQLITE_CHECKPOINT_PASSIVE};
+    if (pages >= thresholds.truncatePages) {
+        mode = SQLITE_CHECKPOINT_TRUNCATE;
+    }
+    else if (pages >= thresholds.restartPages) {
+        mode = SQLITE_CHECKPOINT_RESTART;
+    }
+
+    int logFrames {-1};
+    int checkpointedFrames {-1};
+    int res {SQLITE_ERROR};
+    auto const start = std::chrono::steady_clock::now();
+    try {
+        // a connection learns the database is in WAL mode on its first read
+        (void)connection.prepareCached("PRAGMA schema_version").execute().fieldT<int>();
+        res = sqlite3_wal_checkpoint_v2(connection.sqliteDb, nullptr, mode, &logFrames,
+                                        &checkpointedFrames);
+    }
+    catch (...) {
+        // counted as busy below, and retried on the next commit: the thread must not end
+    }
+    auto const duration = std::chrono::steady_clock::now() - start;
+
+    std::lock_guard lock {mutex};
+    switch (mode) {
+        case SQLITE_CHECKPOINT_TRUNCATE:
+            ++counters.truncate;
+            break;
+        case SQLITE_CHECKPOINT_RESTART:
+            ++counters.restart;
+            break;
+        default:
+            ++counters.passive;
+    }
+    if (res != SQLITE_OK || checkpointedFrames < logFrames) {
+        ++counters.busy;
+    }
+    counters.lastLogFrames = logFrames;
+    counters.lastCheckpointedFrames = checkpointedFrames;
+    counters.lastDuration = duration;
+    counters.maxDuration = std::max<std::chrono::nanoseconds>(counters.maxDuration, duration);
+    counters.totalDuration += duration;
+}
+
+//--------------------------------------------------------------------------------------------------
@@ -0,0 +1,437 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include "cpp4sqlite_pcache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+// sqlite3_pcache_methods2::xCreate has no context, so the installed cache is global
+PageCache* installed {};
+std::atomic<bool> guardActive {false};
+
+int xInit(void*)
+{
+    return SQLITE_OK;
+}
+
+void xShutdown(void*)
+{}
+}  // namespace
+
+/**
+ * Header of each page allocation, followed by the page buffer then sqlite's extra bytes
+ */
+struct PageCache::Page
+{
+    sqlite3_pcache_page handle {};  // first: sqlite hands its address back
+    Cache* owner {};
+    unsigned key {};
+    bool pinned {false};
+    bool referenced {false};  // CLOCK bit
+    Page* prev {};            // shard's CLOCK ring, purgeable pages only
+    Page* next {};
+    std::size_t size {};  // whole allocation
+};
+
+struct PageCache::Cache
+{
+    Shard* shard {};
+    int pageSize {};
+    int extraSize {};
+    bool purgeable {};
+    std::unordered_map<unsigned, Page*> pages {};
+    std::size_t hits {};
+    std::size_t misses {};
+
+    [[nodiscard]] std::size_t pageBytes() const
+    {
+        return sizeof(Page) + static_cast<std::size_t>(pageSize + extraSize);
+    }
+};
+
+struct PageCache::Shard
+{
+    mutable std::mutex mutex {};
+    std::vector<Cache*> caches {};
+    Page* hand {};  // CLOCK ring
+    std::size_t ringSize {};
+    std::size_t hits {};  // includes destroyed caches
+    std::size_t misses {};
+    std::size_t evictions {};
+    std::size_t overBudget {};
+
+    void link(Page* page)
+    {
+        if (hand == nullptr) {
+            page->prev = page->next = page;
+            hand = page;
+        }
+        else {
+            // behind the hand: the last to be considered
+            page->next = hand;
+            page->prev = hand->prev;
+            hand->prev->next = page;
+            hand->prev = page;
+        }
+        ++ringSize;
+    }
+
+    void unlink(Page* page)
+    {
+        if (page->next == page) {
+            hand = nullptr;
+        }
+        else {
+            page->prev->next = page->next;
+            page->next->prev = page->prev;
+            if (hand == page) {
+                hand = page->next;
+            }
+        }
+        page->prev = page->next = nullptr;
+        --ringSize;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+PageCache::PageCache(std::size_t const budgetBytes, std::size_t const shardCount)
+    : budget {budgetBytes}
+{
+    for (std::size_t i = 0; i < std::max<std::size_t>(shardCount, 1); ++i) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+PageCache::~PageCache() = default;
+
+PageCache::Stats PageCache::stats() const
+{
+    Stats totals {};
+    totals.budget = budget;
+    totals.bytes = bytes.load(std::memory_order_relaxed);
+    for (auto const& shard : shards) {
+        std::lock_guard lock {shard->mutex};
+        for (Cache const* cache : shard->caches) {
+            totals.pages += cache->pages.size();
+        }
+        totals.hits += shard->hits;
+        totals.misses += shard->misses;
+        totals.evictions += shard->evictions;
+        totals.overBudget += shard->overBudget;
+    }
+    return totals;
+}
+
+std::vector<PageCache::CacheStats> PageCache::caches() const
+{
+    std::vector<CacheStats> all {};
+    for (auto const& shard : shards) {
+        std::lock_guard lock {shard->mutex};
+        for (Cache const* cache : shard->caches) {
+            all.push_back({cache->pageSize, cache->purgeable, cache->pages.size(), cache->hits,
+                           cache->misses});
+        }
+    }
+    return all;
+}
+
+sqlite3_pcache* PageCache::create(int const pageSize, int const extraSize, int const purgeable)
+{
+    auto& shards = installed->shards;
+    Shard* const shard = shards[installed->nextShard.fetch_add(1) % shards.size()].get();
+    auto* const cache = new (std::nothrow) Cache {shard, pageSize, extraSize, purgeable != 0};
+    if (cache != nullptr) {
+        std::lock_guard lock {shard->mutex};
+        shard->caches.push_back(cache);
+    }
+    return reinterpret_cast<sqlite3_pcache*>(cache);
+}
+
+void PageCache::cachesize(sqlite3_pcache*, int)
+{
+    // the budget governs
+}
+
+int PageCache::pagecount(sqlite3_pcache* handle)
+{
+    auto* const cache = reinterpret_cast<Cache*>(handle);
+    std::lock_guard lock {cache->shard->mutex};
+    return static_cast<int>(cache->pages.size());
+}
+
+sqlite3_pcache_page* PageCache::fetch(sqlite3_pcache* handle,
+                                      unsigned const key,
+                                      int const createFlag)
+{
+    auto* const cache = reinterpret_cast<Cache*>(handle);
+    Shard& shard = *cache->shard;
+    std::lock_guard lock {shard.mutex};
+
+    if (auto const found = cache->pages.find(key); found != cache->pages.end()) {
+        Page* const page = found->second;
+        page->pinned = true;
+        page->referenced = true;
+        ++cache->hits;
+        ++shard.hits;
+        return &page->handle;
+    }
+
+    ++cache->misses;
+    ++shard.misses;
+    if (createFlag == 0) {
+        return nullptr;
+    }
+    Page* const page = installed->allocate(*cache, createFlag);
+    if (page == nullptr) {
+        return nullptr;
+    }
+    page->owner = cache;
+    page->key = key;
+    page->pinned = true;
+    page->referenced = true;
+    std::memset(page->handle.pExtra, 0, static_cast<std::size_t>(cache->extraSize));
+    cache->pages.emplace(key, page);
+    if (cache->purgeable) {
+        shard.link(page);
+    }
+    return &page->handle;
+}
+
+void PageCache::unpin(sqlite3_pcache* handle, sqlite3_pcache_page* pageHandle, int const discard)
+{
+    auto* const cache = reinterpret_cast<Cache*>(handle);
+    auto* const page = reinterpret_cast<Page*>(pageHandle);
+    std::lock_guard lock {cache->shard->mutex};
+    page->pinned = false;
+    if (discard != 0) {
+        cache->pages.erase(page->key);
+        installed->release(*cache, page);
+    }
+}
+
+void PageCache::rekey(sqlite3_pcache* handle,
+                      sqlite3_pcache_page* pageHandle,
+                      unsigned const from,
+                      unsigned const to)
+{
+    auto* const cache = reinterpret_cast<Cache*>(handle);
+    auto* const page = reinterpret_cast<Page*>(pageHandle);
+    std::lock_guard lock {cache->shard->mutex};
+    if (auto const existing = cache->pages.find(to); existing != cache->pages.end()) {
+        Page* const displaced = existing->second;
+        cache->pages.erase(existing);
+        installed->release(*cache, displaced);
+    }
+    cache->pages.erase(from);
+    page->key = to;
+    cache->pages.emplace(to, page);
+}
+
+void PageCache::truncate(sqlite3_pcache* handle, unsigned const limit)
+{
+    auto* const cache = reinterpret_cast<Cache*>(handle);
+    std::lock_guard lock {cache->shard->mutex};
+    for (auto entry = cache->pages.begin(); entry != cache->pages.end();) {
+        if (entry->first >= limit) {
+            installed->release(*cache, entry->second);
+            entry = cache->pages.erase(entry);
+        }
+        else {
+            ++entry;
+        }
+    }
+}
+
+void PageCache::destroy(sqlite3_pcache* handle)
+{
+    auto* const cache = reinterpret_cast<Cache*>(handle);
+    {
+        Shard& shard = *cache->shard;
+        std::lock_guard lock {shard.mutex};
+        for (auto const& [key, page] : cache->pages) {
+            installed->release(*cache, page);
+        }
+        shard.caches.erase(std::find(shard.caches.begin(), shard.caches.end(), cache));
+    }
+    delete cache;
+}
+
+void PageCache::shrink(sqlite3_pcache* handle)
+{
+    auto* const cache = reinterpret_cast<Cache*>(handle);
+    std::lock_guard lock {cache->shard->mutex};
+    for (auto entry = cache->pages.begin(); entry != cache->pages.end();) {
+        if (!entry->second->pinned) {
+            installed->release(*cache, entry->second);
+            entry = cache->pages.erase(entry);
+        }
+        else {
+            ++entry;
+        }
+    }
+}
+
+PageCache::Page* PageCache::allocate(Cache& cache, int const createFlag)
+{
+    std::size_t const size {cache.pageBytes()};
+    Shard& shard = *cache.shard;
+
+    Page* page {};
+    bool reserved {reserve(size)};
+    while (cache.purgeable && page == nullptr && !reserved) {
+        if (!evictOne(shard, size, page) && !evictElsewhere(shard, size, page)) {
+            break;
+        }
+        reserved = page == nullptr && reserve(size);  // freed a page of another size
+    }
+    if (page == nullptr && !reserved) {
+        if (cache.purgeable && createFlag == 1) {
+            return nullptr;  // sqlite spills dirty pages and asks again with 2
+        }
+        ++shard.overBudget;
+        bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    if (page == nullptr) {
+        void* const memory = std::malloc(size);
+        if (memory == nullptr) {
+            bytes.fetch_sub(size, std::memory_order_relaxed);
+            return nullptr;
+        }
+        page = new (memory) Page {};
+    }
+    else {
+        *page = Page {};  // recycled
+    }
+    page->size = size;
+    auto* const buffer = reinterpret_cast<char*>(page) + sizeof(Page);
+    page->handle.pBuf = buffer;
+    page->handle.pExtra = buffer + cache.pageSize;
+    return page;
+}
+
+bool PageCache::evictOne(Shard& shard, std::size_t const pageBytes, Page*& reusable)
+{
+    // two sweeps: the first may only clear reference bits
+    for (std::size_t step = 0; shard.hand != nullptr && step < 2 * shard.ringSize; ++step) {
+        Page* const page = shard.hand;
+        shard.hand = page->next;
+        if (page->pinned) {
+            continue;
+        }
+        if (page->referenced) {
+            page->referenced = false;
+            continue;
+        }
+
+        page->owner->pages.erase(page->key);
+        ++shard.evictions;
+        if (page->size == pageBytes) {
+            shard.unlink(page);
+            reusable = page;
+        }
+        else {
+            release(*page->owner, page);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool PageCache::reserve(std::size_t const size)
+{
+    // shards allocate concurrently: check and add as one, so together they stay within budget
+    std::size_t current {bytes.load(std::memory_order_relaxed)};
+    while (current + size <= budget) {
+        if (bytes.compare_exchange_weak(current, current + size, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PageCache::evictElsewhere(Shard const& own, std::size_t const pageBytes, Page*& reusable)
+{
+    // only tried: two shards each evicting from the other must not wait on each other
+    std::size_t const start {nextVictim.fetch_add(1, std::memory_order_relaxed)};
+    for (std::size_t i = 0; i < shards.size(); ++i) {
+        Shard& shard = *shards[(start + i) % shards.size()];
+        if (&shard == &own) {
+            continue;
+        }
+        std::unique_lock const lock {shard.mutex, std::try_to_lock};
+        if (lock.owns_lock() && evictOne(shard, pageBytes, reusable)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PageCache::release(Cache& cache, Page* page)
+{
+    if (cache.purgeable) {
+        cache.shard->unlink(page);
+    }
+    bytes.fetch_sub(page->size, std::memory_order_relaxed);
+    page->~Page();
+    std::free(page);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+PageCacheInit::PageCacheInit(PageCache& pageCache)
+{
+    if (guardActive.exchange(true)) {
+        throw std::runtime_error("PageCacheInit: a guard already exists");
+    }
+    sqlite3_shutdown();
+    sqlite3_config(SQLITE_CONFIG_GETPCACHE2, &previous);
+
+    installed = &pageCache;
+    static sqlite3_pcache_methods2 const methods {1,
+                                                  nullptr,
+                                                  xInit,
+                                                  xShutdown,
+                                                  PageCache::create,
+                                                  PageCache::cachesize,
+                                                  PageCache::pagecount,
+                                                  PageCache::fetch,
+                                                  PageCache::unpin,
+                                                  PageCache::rekey,
+                                                  PageCache::truncate,
+                                                  PageCache::destroy,
+                                                  PageCache::shrink};
+    int res {sqlite3_config(SQLITE_CONFIG_PCACHE2, &methods)};
+    if (res == SQLITE_OK) {
+        res = sqlite3_initialize();
+    }
+    if (res != SQLITE_OK) {
+        sqlite3_config(SQLITE_CONFIG_PCACHE2, &previous);
+        installed = nullptr;
+        guardActive = false;
+        throw std::runtime_error(std::string {"PageCacheInit error: "} + errString(res));
+    }
+}
+
+PageCacheInit::~PageCacheInit()
+{
+    sqlite3_shutdown();
+    sqlite3_config(SQLITE_CONFIG_PCACHE2, &previous);
+    installed = nullptr;
+    guardActive = false;
+}
+
+//--------------------------------------------------------------------------------------------------
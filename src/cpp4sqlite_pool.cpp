@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include "cpp4sqlite_pool.h"
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+ConnectionPool::Handle::Handle(ConnectionPool* pool, Connection* connection)
+    : pool {pool}
+    , connection {connection}
+{}
+
+ConnectionPool::Handle::Handle(Handle&& other) noexcept
+    : pool {std::exchange(other.pool, nullptr)}
+    , connection {std::exchange(other.connection, nullptr)}
+{}
+
+ConnectionPool::Handle::~Handle()
+{
+    if (pool != nullptr) {
+        pool->checkin(connection);
+    }
+}
+
+Connection& ConnectionPool::Handle::operator*() const
+{
+    return *connection;
+}
+
+Connection* ConnectionPool::Handle::operator->() const
+{
+    return connection;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+ConnectionConfig ConnectionPool::defaultConfig()
+{
+    ConnectionConfig config {};
+    config.busyTimeout = std::chrono::seconds {5};
+    return config;
+}
+
+ConnectionPool::ConnectionPool(std::string const& path,
+                               std::size_t const readerCount,
+                               std::size_t const statementCacheCapacity,
+                               ConnectionConfig const& config)
+{
+    auto pooled {config};
+    pooled.journalMode.reset();
+
+    writerConnection =
+        std::make_unique<Connection>(path, OpenOption::CREATERW | OpenOption::NOMUTEX, pooled);
+    writerConnection->setStatementCacheCapacity(statementCacheCapacity);
+    auto const mode = writerConnection->prepare("PRAGMA journal_mode = WAL").execute().fieldS();
+    if (mode != "wal") {
+        throw std::runtime_error("ConnectionPool: cannot use WAL mode, journal_mode is " + mode);
+    }
+
+    for (std::size_t i = 0; i < readerCount; ++i) {
+        readers.push_back(std::make_unique<Connection>(
+            path, OpenOption::READONLY | OpenOption::NOMUTEX, pooled));
+        readers.back()->setStatementCacheCapacity(statementCacheCapacity);
+        idle.push_back(readers.back().get());
+    }
+}
+
+ConnectionPool::~ConnectionPool() = default;
+
+ConnectionPool::Handle ConnectionPool::reader(std::chrono::milliseconds const timeout)
+{
+    return {this, checkout(false, timeout)};
+}
+
+ConnectionPool::Handle ConnectionPool::writer(std::chrono::milliseconds const timeout)
+{
+    return {this, checkout(true, timeout)};
+}
+
+Connection* ConnectionPool::checkout(bool const writer, std::chrono::milliseconds const timeout)
+{
+    std::unique_lock lock {mutex};
+    auto available = [&] {
+        return writer ? writerIdle : !idle.empty();
+    };
+
+    ++counters.checkouts;
+    if (!available()) {
+        ++counters.exhausted;
+        auto const start = Clock::now();
+        bool const ok = released.wait_for(lock, timeout, available);
+        auto const waited = Clock::now() - start;
+        counters.totalWait += waited;
+        counters.maxWait = std::max(counters.maxWait, waited);
+        if (!ok) {
+            ++counters.timeouts;
+            throw std::runtime_error(writer ? "ConnectionPool: writer checkout timed out"
+                                            : "ConnectionPool: reader checkout timed out");
+        }
+    }
+
+    if (writer) {
+        writerIdle = false;
+        return writerConnection.get();
+    }
+    Connection* const connection = idle.back();
+    idle.pop_back();
+    return connection;
+}
+
+void ConnectionPool::checkin(Connection* connection)
+{
+    {
+        std::lock_guard lock {mutex};
+        if (connection == writerConnection.get()) {
+            writerIdle = true;
+        }
+        else {
+            idle.push_back(connection);
+        }
+    }
+    released.notify_all();
+}
+
+std::size_t ConnectionPool::readerCount() const
+{
+    return readers.size();
+}
+
+std::size_t ConnectionPool::idleReaders() const
+{
+    std::lock_guard lock {mutex};
+    return idle.size();
+}
+
+ConnectionPool::Metrics ConnectionPool::metrics() const
+{
+    std::lock_guard lock {mutex};
+    return counters;
+}
+
+void ConnectionPool::resetMetrics()
+{
+    std::lock_guard lock {mutex};
+    counters = {};
+}
+
+//--------------------------------------------------------------------------------------------------
@@ -0,0 +1,265 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include "cpp4sqlite_profile.h"
+
+#include <cctype>
+#include <cmath>
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+int LatencyHistogram::bucketOf(std::uint64_t const nanos)
+{
+    if (nanos < subBuckets) {
+        return static_cast<int>(nanos);
+    }
+    int exponent {63};
+    while ((nanos >> exponent) == 0) {
+        --exponent;
+    }
+    auto const sub = static_cast<int>((nanos >> (exponent - subBucketBits)) & (subBuckets - 1));
+    return (exponent - subBucketBits + 1) * subBuckets + sub;
+}
+
+std::uint64_t LatencyHistogram::upperBound(int const bucket)
+{
+    if (bucket < subBuckets) {
+        return static_cast<std::uint64_t>(bucket);
+    }
+    int const exponent {bucket / subBuckets + subBucketBits - 1};
+    auto const sub = static_cast<std::uint64_t>(bucket % subBuckets);
+    int const shift {exponent - subBucketBits};
+    auto const lower = ((subBuckets + sub) << shift);
+    return lower + ((std::uint64_t {1} << shift) - 1);
+}
+
+void LatencyHistogram::record(std::uint64_t const nanos)
+{
+    counts[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(nanos, std::memory_order_relaxed);
+    auto seenMax = max.load(std::memory_order_relaxed);
+    while (nanos > seenMax
+           && !max.compare_exchange_weak(seenMax, nanos, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& bucket : counts) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::snapshot(QueryProfile& profile) const
+{
+    using std::chrono::nanoseconds;
+
+    std::array<std::uint64_t, bucketCount> copy {};
+    std::uint64_t samples {0};
+    for (int i = 0; i < bucketCount; ++i) {
+        copy[i] = counts[i].load(std::memory_order_relaxed);
+        samples += copy[i];
+    }
+    auto const maxNanos = max.load(std::memory_order_relaxed);
+
+    profile.count = samples;
+    profile.total = nanoseconds {total.load(std::memory_order_relaxed)};
+    profile.max = nanoseconds {maxNanos};
+    profile.buckets.clear();
+
+    // percentile p is the bound of the bucket holding the ceil(p * samples)th sample
+    auto const rank = [samples](double const p) {
+        auto const r = std::ceil(p * static_cast<double>(samples));
+        return std::max<std::uint64_t>(1, static_cast<std::uint64_t>(r));
+    };
+    std::array<std::pair<std::uint64_t, nanoseconds*>, 3> const targets {
+        {{rank(0.5), &profile.p50}, {rank(0.99), &profile.p99}, {rank(0.999), &profile.p999}}};
+    for (auto const& [target, out] : targets) {
+        *out = {};
+    }
+
+    std::uint64_t seenSamples {0};
+    for (int i = 0; i < bucketCount; ++i) {
+        if (copy[i] == 0) {
+            continue;
+        }
+        auto const bound = std::min(upperBound(i), maxNanos);
+        profile.buckets.emplace_back(nanoseconds {upperBound(i)}, copy[i]);
+        std::uint64_t const before {seenSamples};
+        seenSamples += copy[i];
+        for (auto const& [target, out] : targets) {
+            if (before < target && target <= seenSamples) {
+                *out = nanoseconds {bound};
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int Profiler::traceCallback(unsigned const type, void* context, void* stmnt, void* nanos)
+{
+    if (type == SQLITE_TRACE_PROFILE) {
+        static_cast<Profiler*>(context)->record(
+            static_cast<sqlite3_stmt*>(stmnt),
+            static_cast<std::uint64_t>(*static_cast<sqlite3_int64*>(nanos)));
+    }
+    return 0;
+}
+
+void Profiler::record(sqlite3_stmt* stmnt, std::uint64_t const nanos)
+{
+    histogramFor(fixNullStr(sqlite3_sql(stmnt)))->record(nanos);
+}
+
+LatencyHistogram* Profiler::histogramFor(std::string_view const sql)
+{
+    if (auto const found = seen.find(sql); found != seen.end()) {
+        return found->second;
+    }
+
+    // first sight of this sql text on this thread: resolve its shape
+    if (seen.size() >= seenLimit) {
+        seen.clear();
+        seenSql.clear();
+    }
+    LatencyHistogram* histogram {};
+    {
+        std::lock_guard lock {mutex};
+        auto& shape = shapes[normalise(sql)];
+        if (!shape) {
+            shape = std::make_unique<LatencyHistogram>();
+        }
+        histogram = shape.get();
+    }
+    seen.emplace(seenSql.emplace_back(sql), histogram);
+    return histogram;
+}
+
+std::vector<QueryProfile> Profiler::snapshot() const
+{
+    std::lock_guard lock {mutex};
+    std::vector<QueryProfile> profiles {};
+    profiles.reserve(shapes.size());
+    for (auto const& [sql, histogram] : shapes) {
+        QueryProfile& profile = profiles.emplace_back();
+        profile.sql = sql;
+        histogram->snapshot(profile);
+    }
+    return profiles;
+}
+
+void Profiler::reset()
+{
+    std::lock_guard lock {mutex};
+    for (auto const& shape : shapes) {
+        shape.second->reset();
+    }
+}
+
+std::string Profiler::normalise(std::string_view const sql)
+{
+    auto const isWordChar = [](char const c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$'
+            || static_cast<unsigned char>(c) >= 0x80;
+    };
+
+    std::string out {};
+    out.reserve(sql.size());
+    bool pendingSpace {false};
+    auto const emit = [&](std::string_view const token) {
+        if (pendingSpace && !out.empty()) {
+            out += ' ';
+        }
+        pendingSpace = false;
+        out += token;
+    };
+
+    std::size_t i {0};
+    while (i < sql.size()) {
+        char const c {sql[i]};
+        auto const rest = sql.substr(i);
+
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pendingSpace = true;
+            ++i;
+        }
+        else if (rest.substr(0, 2) == "--") {
+            auto const end = sql.find('\n', i);
+            i = end == std::string_view::npos ? sql.size() : end;
+            pendingSpace = true;
+        }
+        else if (rest.substr(0, 2) == "/*") {
+            auto const end = sql.find("*/", i + 2);
+            i = end == std::string_view::npos ? sql.size() : end + 2;
+            pendingSpace = true;
+        }
+        else if (c == '\'' || ((c == 'x' || c == 'X') && rest.size() > 1 && rest[1] == '\'')) {
+            // string or blob literal, '' escapes a quote
+            i += c == '\'' ? 1 : 2;
+            while (i < sql.size()) {
+                if (sql[i] == '\'' && (i + 1 >= sql.size() || sql[i + 1] != '\'')) {
+                    ++i;
+                    break;
+                }
+                i += sql[i] == '\'' ? 2 : 1;
+            }
+            emit("?");
+        }
+        else if (c == '"' || c == '`' || c == '[') {
+            // quoted identifier: kept
+            char const close {c == '[' ? ']' : c};
+            auto const end = sql.find(close, i + 1);
+            auto const stop = end == std::string_view::npos ? sql.size() : end + 1;
+            emit(sql.substr(i, stop - i));
+            i = stop;
+        }
+        else if (c == '?') {
+            // parameter, kept with any number
+            auto stop {i + 1};
+            while (stop < sql.size() && std::isdigit(static_cast<unsigned char>(sql[stop]))) {
+                ++stop;
+            }
+            emit(sql.substr(i, stop - i));
+            i = stop;
+        }
+        else if (std::isdigit(static_cast<unsigned char>(c))
+                 || (c == '.' && rest.size() > 1
+                     && std::isdigit(static_cast<unsigned char>(rest[1])))) {
+            // numeric literal: identifiers holding digits are taken whole below
+            ++i;
+            while (i < sql.size()
+                   && (isWordChar(sql[i]) || sql[i] == '.'
+                       || ((sql[i] == '+' || sql[i] == '-')
+                           && (sql[i - 1] == 'e' || sql[i - 1] == 'E')))) {
+                ++i;
+            }
+            emit("?");
+        }
+        else if (isWordChar(c)) {
+            auto stop {i};
+            while (stop < sql.size() && isWordChar(sql[stop])) {
+                ++stop;
+            }
+            emit(sql.substr(i, stop - i));
+            i = stop;
+        }
+        else {
+            emit(sql.substr(i, 1));
+            ++i;
+        }
+    }
+    if (!out.empty() && out.back() == ';') {
+        out.pop_back();
+    }
+    return out;
+}
+
+//--------------------------------------------------------------------------------------------------
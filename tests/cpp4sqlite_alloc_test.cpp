@@ -0,0 +1,99 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+// Own executable: SqliteInit needs a process with no open connections
+
+#include <thread>
+
+#include <cpp4sqlite_alloc.h>
+#include <gtest/gtest.h>
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(AllocTests, size_classes_cover_pooled_sizes)
+{
+    for (int size = 1; size <= PoolAllocator::maxPooled; ++size) {
+        int const sizeClass {PoolAllocator::sizeClass(size)};
+        ASSERT_LT(sizeClass, PoolAllocator::classCount);
+        ASSERT_GE(PoolAllocator::classSize(sizeClass), size);
+        if (sizeClass > 0) {
+            ASSERT_LT(PoolAllocator::classSize(sizeClass - 1), size);
+        }
+    }
+    EXPECT_EQ(-1, PoolAllocator::sizeClass(PoolAllocator::maxPooled + 1));
+}
+
+TEST(AllocTests, pool_reuses_freed_blocks)
+{
+    PoolAllocator pool {};
+
+    void* const first = pool.allocate(100);
+    EXPECT_EQ(112, pool.size(first));
+    pool.deallocate(first);
+    EXPECT_EQ(first, pool.allocate(100));
+
+    auto* const text = static_cast<char*>(pool.reallocate(first, 10));
+    std::strcpy(text, "retained");
+    auto* const grown = static_cast<char*>(pool.reallocate(text, 5000));
+    EXPECT_STREQ("retained", grown);
+    EXPECT_GE(pool.size(grown), 5000);
+    pool.deallocate(grown);
+
+    EXPECT_EQ(3, pool.stats().systemAllocs);  // 100, then shrunk to a smaller class, then 5000
+}
+
+TEST(AllocTests, guard_installs_pool_for_sqlite)
+{
+    PoolAllocator pool {};
+    {
+        SqliteInit const init {pool};
+
+        auto work = [] {
+            Connection conn {":memory:", OpenOption::READWRITE};
+            conn.quickQuery("CREATE TABLE t(a); INSERT INTO t VALUES (randomblob(100000))");
+            for (int i = 0; i < 100; ++i) {
+                (void)conn.prepareCached("SELECT length(a) FROM t").execute().fieldT<int>();
+            }
+        };
+        std::vector<std::thread> threads {};
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back(work);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        EXPECT_GT(ProcessStatus::snapshot().memoryUsed.highwater, 100000);
+        EXPECT_GT(pool.stats().systemAllocs, 0);
+        EXPECT_GT(pool.stats().largeAllocs, 0);
+
+        EXPECT_THROW(SqliteInit {pool}, std::runtime_error);
+    }
+
+    // default allocator again
+    Connection conn {":memory:", OpenOption::READWRITE};
+    EXPECT_EQ(3, conn.prepare("SELECT 3").execute().fieldT<int>());
+}
+
+TEST(AllocTests, heap_needs_memsys5)
+{
+    std::vector<std::byte> buffer(1 << 20);
+    SqliteInit::Heap const heap {buffer.data(), static_cast<int>(buffer.size()), 64};
+
+    if (SqliteInit::heapSupported()) {
+        SqliteInit const init {heap};
+        Connection conn {":memory:", OpenOption::READWRITE};
+        EXPECT_EQ(3, conn.prepare("SELECT 3").execute().fieldT<int>());
+    }
+    else {
+        EXPECT_THROW(SqliteInit {heap}, std::runtime_error);
+    }
+
+    PoolAllocator pool {};
+    SqliteInit const init {pool};  // a failed guard leaves none behind
+}
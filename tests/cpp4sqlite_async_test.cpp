@@ -0,0 +1,136 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include <cpp4sqlite_async.h>
+#include <gtest/gtest.h>
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(AsyncTests, query_materialises_typed_rows)
+{
+    AsyncConnection async {":memory:", OpenOption::READWRITE};
+    (void)async.executeScript("CREATE TABLE t(a, b); INSERT INTO t VALUES (1, 'x'), (2, NULL)");
+
+    std::string const name {"x"};
+    auto result = async.query("SELECT a, b FROM t WHERE b = ? OR a > ?", name.c_str(), 1).get();
+
+    EXPECT_EQ((SqlColNames {"a", "b"}), result.columns);
+    ASSERT_EQ(2, result.rows.size());
+    EXPECT_EQ(SqlValue {sqlite3_int64 {1}}, result.rows[0][0]);
+    EXPECT_EQ(SqlValue {std::string {"x"}}, result.rows[0][1]);
+    EXPECT_EQ(SqlValue {nullptr}, result.rows[1][1]);
+}
+
+TEST(AsyncTests, query_copies_string_view_params)
+{
+    AsyncConnection async {":memory:", OpenOption::READWRITE};
+    std::promise<void> gate {};
+    auto blocked = async.submit([wait = gate.get_future()](Connection&) {
+        wait.wait();
+    });
+
+    auto text = std::make_unique<std::string>(32, 'a');
+    auto future = async.query("SELECT ?", std::string_view {*text});
+    text->assign(32, 'b');
+    text.reset();
+    gate.set_value();
+
+    EXPECT_EQ(SqlValue {std::string(32, 'a')}, future.get().rows.at(0).at(0));
+}
+
+TEST(AsyncTests, exception_delivered_through_future)
+{
+    AsyncConnection async {":memory:", OpenOption::READWRITE};
+
+    auto future = async.executeScript("SELECT * FROM missing");
+
+    EXPECT_THROW(future.get(), std::runtime_error);
+    EXPECT_EQ(3, async.submit([](Connection& conn) {
+                          return conn.prepare("SELECT 3").execute().fieldT<int>();
+                      })
+                     .get());
+}
+
+TEST(AsyncTests, stream_delivers_batches)
+{
+    AsyncConnection async {":memory:", OpenOption::READWRITE};
+    (void)async.executeScript("CREATE TABLE t(a)");
+    (void)async.submit([](Connection& conn) {
+        std::vector<int> const rows {1, 2, 3, 4, 5};
+        return conn.prepare("INSERT INTO t VALUES (?)").executeMany(rows);
+    });
+
+    std::vector<std::size_t> sizes {};
+    auto onBatch = [&](SqlColNames const& columns, AsyncConnection::RowBatch&& batch) {
+        EXPECT_EQ(SqlColNames {"a"}, columns);
+        sizes.push_back(batch.size());
+    };
+    auto const total = async.stream("SELECT a FROM t WHERE a > ?", 2, onBatch, 0).get();
+
+    EXPECT_EQ(5, total);
+    EXPECT_EQ((std::vector<std::size_t> {2, 2, 1}), sizes);
+}
+
+TEST(AsyncTests, full_queue_refuses_trySubmit)
+{
+    AsyncConnection async {":memory:", OpenOption::READWRITE, 1};
+    std::promise<void> gate {};
+    std::promise<void> started {};
+
+    auto blocked = async.submit([&, wait = gate.get_future()](Connection&) {
+        started.set_value();
+        wait.wait();
+    });
+    started.get_future().wait();
+    auto queued = async.submit([](Connection&) {
+        return 1;
+    });
+
+    EXPECT_EQ(1, async.pending());
+    EXPECT_FALSE(async.trySubmit([](Connection&) {}).has_value());
+
+    gate.set_value();
+    EXPECT_EQ(1, queued.get());
+    EXPECT_TRUE(async.trySubmit([](Connection&) {}).has_value());
+}
+
+TEST(AsyncTests, submit_from_worker_to_full_queue_throws)
+{
+    AsyncConnection async {":memory:", OpenOption::READWRITE, 1};
+    std::promise<void> gate {};
+
+    auto outer = async.submit([&async, wait = gate.get_future()](Connection&) {
+        wait.wait();
+        return async.submit([](Connection&) {
+            return 1;
+        });
+    });
+    auto queued = async.submit([](Connection&) {
+        return 2;
+    });
+    gate.set_value();
+
+    EXPECT_THROW((void)outer.get(), std::runtime_error);
+    EXPECT_EQ(2, queued.get());
+}
+
+TEST(AsyncTests, destructor_drains_queue_in_order)
+{
+    std::vector<int> order {};
+    {
+        AsyncConnection async {":memory:", OpenOption::READWRITE};
+        for (int i = 0; i < 50; ++i) {
+            (void)async.submit([&order, i](Connection&) {
+                order.push_back(i);
+            });
+        }
+    }
+
+    ASSERT_EQ(50, order.size());
+    EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+}
@@ -0,0 +1,118 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include <cpp4sqlite_backup.h>
+#include <gtest/gtest.h>
+
+#include "cpp4sqlite_temp_db.h"
+
+using namespace cpp4sqlite;
+
+class BackupTests: public testing::Test
+{
+protected:
+    TempDatabase const sourcePath {"cpp4sqlite_backup_source.db"};
+    TempDatabase const copyPath {"cpp4sqlite_backup_copy.db"};
+    std::unique_ptr<Connection> source {};
+
+    void SetUp() override
+    {
+        ConnectionConfig config {};
+        config.journalMode = JournalMode::wal;
+        source = std::make_unique<Connection>(sourcePath.string(), OpenOption::CREATERW, config);
+        source->quickQuery("CREATE TABLE t(a INTEGER PRIMARY KEY, b);"
+                           "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+                           "WHERE i < 1000) INSERT INTO t SELECT i, randomblob(1000) FROM n");
+    }
+
+    [[nodiscard]] int copyRows() const
+    {
+        Connection copy {copyPath.string(), OpenOption::READONLY};
+        EXPECT_EQ("ok", copy.prepare("PRAGMA integrity_check").execute().fieldS());
+        return copy.prepare("SELECT count(*) FROM t").execute().fieldT<int>().value_or(-1);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+TEST_F(BackupTests, copies_in_steps_with_progress)
+{
+    std::vector<Backup::Progress> reports {};
+    {
+        Backup backup {*source, copyPath.string(), {10, std::chrono::milliseconds {0}}};
+        EXPECT_TRUE(backup.run([&reports](Backup::Progress const& progress) {
+            reports.push_back(progress);
+        }));
+    }
+
+    ASSERT_GT(reports.size(), 10);
+    EXPECT_EQ(1, reports.front().steps);
+    EXPECT_GT(reports.front().remaining, reports.back().remaining);
+    EXPECT_EQ(0, reports.back().remaining);
+    EXPECT_EQ(reports.size(), reports.back().steps);
+    EXPECT_EQ(1000, copyRows());
+}
+
+TEST_F(BackupTests, background_copy_is_consistent_with_concurrent_writes)
+{
+    Backup backup {*source, copyPath.string(), {20, std::chrono::milliseconds {1}}};
+    backup.start();
+    {
+        Connection writer {sourcePath.string(), OpenOption::READWRITE};
+        for (int i = 0; i < 20; ++i) {
+            writer.prepare("INSERT INTO t(b) VALUES (randomblob(1000))").execute();
+        }
+    }
+    EXPECT_TRUE(backup.wait());
+
+    auto const rows = copyRows();
+    EXPECT_GE(rows, 1000);
+    EXPECT_LE(rows, 1020);
+    EXPECT_EQ(0, backup.progress().remaining);
+}
+
+TEST_F(BackupTests, cancel_stops_background_copy)
+{
+    Backup backup {*source, copyPath.string(), {1, std::chrono::seconds {10}}};
+    auto const start = std::chrono::steady_clock::now();
+    backup.start();
+    backup.cancel();
+    EXPECT_FALSE(backup.wait());
+
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds {5});
+    EXPECT_GT(backup.progress().remaining, 0);
+}
+
+TEST_F(BackupTests, copies_again_after_cancel)
+{
+    Backup backup {*source, copyPath.string(), {10, std::chrono::milliseconds {0}}};
+    backup.cancel();
+    EXPECT_TRUE(backup.run());
+    EXPECT_EQ(1000, copyRows());
+
+    backup.start();
+    EXPECT_TRUE(backup.wait());
+}
+
+TEST_F(BackupTests, error_rethrown_by_wait)
+{
+    Backup::Options options {};
+    options.sourceName = "nonesuch";
+    Backup backup {*source, copyPath.string(), options};
+    EXPECT_THROW(backup.run(), std::runtime_error);
+    backup.start();
+    EXPECT_THROW(backup.wait(), std::runtime_error);
+}
+
+TEST_F(BackupTests, vacuum_into_snapshot)
+{
+    Backup::vacuumInto(*source, copyPath.string());
+
+    EXPECT_EQ(1000, copyRows());
+    EXPECT_THROW(Backup::vacuumInto(*source, copyPath.string()), std::runtime_error);
+}
+
+//--------------------------------------------------------------------------------------------------
@@ -0,0 +1,149 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include <thread>
+
+#include <cpp4sqlite_checkpoint.h>
+#include <gtest/gtest.h>
+
+#include "cpp4sqlite_temp_db.h"
+
+using namespace cpp4sqlite;
+
+class CheckpointTests: public testing::Test
+{
+protected:
+    TempDatabase const dbPath {"cpp4sqlite_checkpoint_test.db"};
+    std::unique_ptr<Connection> writer {};
+
+    void SetUp() override
+    {
+        ConnectionConfig config {};
+        config.journalMode = JournalMode::wal;
+        config.busyTimeout = std::chrono::seconds {5};  // RESTART and TRUNCATE hold off writers
+        writer = std::make_unique<Connection>(dbPath.string(), OpenOption::CREATERW, config);
+        writer->quickQuery("CREATE TABLE t(a)");
+    }
+
+    void commit(int const rows = 10) const
+    {
+        writer->quickQuery("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+                           "WHERE i < " + std::to_string(rows) + ") "
+                           "INSERT INTO t SELECT randomblob(1000) FROM n");
+    }
+
+    template<typename Predicate>
+    static bool waitFor(Predicate predicate)
+    {
+        for (int i = 0; i < 500 && !predicate(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds {10});
+        }
+        return predicate();
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+TEST_F(CheckpointTests, passive_checkpoint_off_the_commit_path)
+{
+    CheckpointScheduler scheduler {dbPath.string(), {20, 1000, 2000}};
+    scheduler.watch(*writer);
+
+    for (int i = 0; i < 10; ++i) {
+        commit();
+    }
+    EXPECT_TRUE(waitFor([&] {
+        return scheduler.stats().passive > 0;
+    }));
+
+    auto const stats = scheduler.stats();
+    EXPECT_EQ(10, stats.commits);
+    EXPECT_GT(stats.walFileBytes, 0);
+    EXPECT_GT(stats.lastLogFrames, 0);
+    EXPECT_GT(stats.totalDuration.count(), 0);
+    EXPECT_GE(stats.maxDuration, stats.lastDuration);
+    EXPECT_EQ(0, stats.restart + stats.truncate);
+}
+
+TEST_F(CheckpointTests, escalates_while_readers_hold_the_wal)
+{
+    CheckpointScheduler scheduler {dbPath.string(), {10, 20, 40, std::chrono::milliseconds {10}}};
+    scheduler.watch(*writer);
+    {
+        Connection reader {dbPath.string(), OpenOption::READONLY};
+        auto transaction = reader.transaction();
+        (void)reader.prepare("SELECT count(*) FROM t").execute().fieldT<int>();
+
+        while (scheduler.stats().walPages < 40) {
+            commit();
+        }
+        EXPECT_TRUE(waitFor([&] {
+            auto const stats = scheduler.stats();
+            return stats.truncate > 0 && stats.busy > 0;
+        }));
+    }
+
+    auto const before = scheduler.stats().truncate;
+    commit(1);
+    EXPECT_TRUE(waitFor([&] {
+        auto const stats = scheduler.stats();
+        return stats.truncate > before && stats.walFileBytes == 0;
+    }));
+}
+
+TEST_F(CheckpointTests, failed_checkpoint_counted_and_retried)
+{
+    CheckpointScheduler scheduler {dbPath.string(), {1, 1000, 2000, std::chrono::milliseconds {1}}};
+    scheduler.watch(*writer);
+
+    writer->quickQuery("PRAGMA locking_mode = EXCLUSIVE");
+    commit();  // the writer keeps its lock: the scheduler's connection cannot read
+    EXPECT_TRUE(waitFor([&] {
+        return scheduler.stats().busy > 0;
+    }));
+
+    writer->quickQuery("PRAGMA locking_mode = NORMAL");
+    commit();  // and releases it
+    EXPECT_TRUE(waitFor([&] {
+        auto const stats = scheduler.stats();
+        return stats.lastLogFrames > 0 && stats.lastCheckpointedFrames == stats.lastLogFrames;
+    }));
+    scheduler.unwatch(*writer);
+}
+
+TEST_F(CheckpointTests, attached_database_commits_ignored)
+{
+    TempDatabase const attachedPath {"cpp4sqlite_checkpoint_attached.db"};
+    CheckpointScheduler scheduler {dbPath.string()};
+    scheduler.watch(*writer);
+    commit();
+    auto const walPages = scheduler.stats().walPages;
+
+    writer->quickQuery("ATTACH '" + attachedPath.string() + "' AS other;"
+                       "PRAGMA other.journal_mode = WAL;"
+                       "CREATE TABLE other.t(a);"
+                       "INSERT INTO other.t VALUES (1)");
+    auto const stats = scheduler.stats();
+    EXPECT_EQ(1, stats.commits);
+    EXPECT_EQ(walPages, stats.walPages);
+
+    scheduler.unwatch(*writer);
+    writer->quickQuery("DETACH other");
+}
+
+TEST_F(CheckpointTests, unwatch_restores_auto_checkpoint)
+{
+    CheckpointScheduler scheduler {dbPath.string()};
+    scheduler.watch(*writer);
+    commit();
+    scheduler.unwatch(*writer);
+    commit();
+
+    EXPECT_EQ(1, scheduler.stats().commits);
+    EXPECT_EQ(1000, std::stoi(writer->prepare("PRAGMA wal_autocheckpoint").execute().fieldS()));
+}
+
+//--------------------------------------------------------------------------------------------------
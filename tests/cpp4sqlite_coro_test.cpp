@@ -0,0 +1,243 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include <atomic>
+#include <deque>
+#include <ranges>
+
+#include <cpp4sqlite_coro.h>
+#include <gtest/gtest.h>
+
+using namespace cpp4sqlite;
+
+namespace
+{
+/**
+ * Eagerly started, fire and forget coroutine
+ */
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object()
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {}
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+/**
+ * Single threaded executor: the resumer posts, the test thread runs
+ */
+class Executor
+{
+    std::mutex mutex {};
+    std::condition_variable posted {};
+    std::deque<std::coroutine_handle<>> ready {};
+
+public:
+    Resumer resumer()
+    {
+        return [this](std::coroutine_handle<> coro) {
+            {
+                std::lock_guard lock {mutex};
+                ready.push_back(coro);
+            }
+            posted.notify_one();
+        };
+    }
+
+    void runOne()
+    {
+        std::unique_lock lock {mutex};
+        posted.wait(lock, [this] {
+            return !ready.empty();
+        });
+        auto const coro = ready.front();
+        ready.pop_front();
+        lock.unlock();
+        coro.resume();
+    }
+};
+
+struct Pair
+{
+    int id;
+    std::string name;
+};
+
+Detached query(AsyncConnection& async, Resumer resumer, int id, std::vector<int>& done)
+{
+    QueryResult const result = co_await execute(async, std::move(resumer), "SELECT ? * 2", id);
+    done.push_back(static_cast<int>(std::get<sqlite3_int64>(result.rows.at(0).at(0))));
+}
+
+Detached echo(AsyncConnection& async, std::string_view text, std::string& out)
+{
+    QueryResult const result = co_await execute(async, {}, "SELECT ?", text);
+    out = std::get<std::string>(result.rows.at(0).at(0));
+}
+
+Detached failing(AsyncConnection& async, std::string& error)
+{
+    try {
+        (void)co_await execute(async, {}, "SELECT * FROM missing");
+    }
+    catch (std::runtime_error const& e) {
+        error = e.what();
+    }
+}
+}  // namespace
+
+static_assert(std::ranges::input_range<Resultset::TypedRange<int>>);
+static_assert(std::ranges::input_range<Resultset::RowsAs<Pair>>);
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(CoroTests, generator_yields_rows_lazily)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a); INSERT INTO t VALUES (1), (2), (3)");
+
+    std::vector<sqlite3_int64> actual {};
+    for (RowView const& row : rows(conn.prepareCached("SELECT a FROM t WHERE a >= ?"), 2)) {
+        actual.push_back(row[0].int64());
+    }
+
+    EXPECT_EQ((std::vector<sqlite3_int64> {2, 3}), actual);
+}
+
+TEST(CoroTests, generator_rethrows_bind_error)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    auto generator = rows(conn.prepare("SELECT ?"), 1, 2);
+
+    EXPECT_THROW((void)generator.begin(), std::runtime_error);
+}
+
+TEST(CoroTests, typed_range_composes_with_views)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a); INSERT INTO t VALUES (1), (2), (3), (4)");
+    auto statement = conn.prepare("SELECT a FROM t");
+    auto resultSet = statement.execute();
+
+    std::vector<int> actual {};
+    for (auto const& [a] : resultSet.as<int>() | std::views::filter([](auto const& row) {
+                               return std::get<0>(row) % 2 == 0;
+                           })) {
+        actual.push_back(a);
+    }
+
+    EXPECT_EQ((std::vector<int> {2, 4}), actual);
+}
+
+TEST(CoroTests, rows_as_range_composes_with_views)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(id, name); INSERT INTO t VALUES (1, 'one'), (2, 'two')");
+    auto statement = conn.prepare("SELECT id, name FROM t");
+    auto resultSet = statement.execute();
+
+    std::vector<std::string> actual {};
+    for (auto const& name : resultSet.rowsAs<Pair>() | std::views::transform(&Pair::name)) {
+        actual.push_back(name);
+    }
+
+    EXPECT_EQ((std::vector<std::string> {"one", "two"}), actual);
+}
+
+TEST(CoroTests, awaited_queries_interleave_on_one_thread)
+{
+    AsyncConnection async {":memory:"};
+    Executor executor {};
+    std::vector<int> done {};
+
+    int const count {100};
+    for (int i = 0; i < count; ++i) {
+        query(async, executor.resumer(), i, done);
+    }
+    EXPECT_TRUE(done.empty());  // all suspended, none blocked the thread
+
+    for (int i = 0; i < count; ++i) {
+        executor.runOne();
+    }
+    ASSERT_EQ(count, done.size());
+    EXPECT_EQ(2 * (count - 1), done.back());
+}
+
+TEST(CoroTests, resumer_runs_on_after_handing_off)
+{
+    std::promise<void> frameGone {};
+    std::atomic<std::size_t> seen {};
+    std::vector<int> done {};
+    Executor executor {};
+    {
+        AsyncConnection async {":memory:"};
+        auto resumer = [post = executor.resumer(), gone = frameGone.get_future().share(), &seen,
+                        state = std::string(64, 'x')](std::coroutine_handle<> coro) {
+            post(coro);
+            gone.wait();
+            seen = state.size();
+        };
+        query(async, resumer, 1, done);
+
+        executor.runOne();  // the coroutine completes and its frame is freed
+        frameGone.set_value();
+    }
+
+    ASSERT_EQ(1, done.size());
+    EXPECT_EQ(64, seen);
+}
+
+TEST(CoroTests, awaited_params_outlive_the_callers_buffer)
+{
+    std::string out {};
+    {
+        AsyncConnection async {":memory:"};
+        std::promise<void> gate {};
+        auto blocked = async.submit([wait = gate.get_future()](Connection&) {
+            wait.wait();
+        });
+
+        auto text = std::make_unique<std::string>(32, 'a');
+        echo(async, *text, out);  // suspended behind the blocked job
+        text->assign(32, 'b');
+        text.reset();
+        gate.set_value();
+    }  // resumed inline on the worker, which the destructor joins
+
+    EXPECT_EQ(std::string(32, 'a'), out);
+}
+
+TEST(CoroTests, awaited_error_rethrown_in_coroutine)
+{
+    std::string error {};
+    {
+        AsyncConnection async {":memory:"};
+        failing(async, error);
+    }  // resumed inline on the worker, which the destructor joins
+
+    EXPECT_NE(std::string::npos, error.find("no such table"));
+}
@@ -0,0 +1,149 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+// Own executable: PageCacheInit needs a process with no open connections
+
+#include <atomic>
+#include <thread>
+
+#include <cpp4sqlite_pcache.h>
+#include <gtest/gtest.h>
+
+#include "cpp4sqlite_temp_db.h"
+
+using namespace cpp4sqlite;
+
+class PageCacheTests: public testing::Test
+{
+protected:
+    static constexpr std::size_t budget {256 * 1024};
+
+    TempDatabase const dbPath {"cpp4sqlite_pcache_test.db"};
+};
+
+//--------------------------------------------------------------------------------------------------
+
+TEST_F(PageCacheTests, connections_share_one_budget)
+{
+    PageCache cache {budget, 4};
+    {
+        PageCacheInit const init {cache};
+        {
+            Connection conn {dbPath.string(), OpenOption::CREATERW};
+            conn.quickQuery("CREATE TABLE t(a INTEGER PRIMARY KEY, b);"
+                            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+                            "WHERE i < 2000) INSERT INTO t SELECT i, randomblob(1000) FROM n");
+        }
+
+        std::atomic<std::size_t> peakBytes {0};
+        auto sample = [&] {
+            std::size_t const bytes {cache.stats().bytes};
+            std::size_t peak {peakBytes};
+            while (bytes > peak && !peakBytes.compare_exchange_weak(peak, bytes)) {
+            }
+        };
+        auto scan = [&] {
+            Connection conn {dbPath.string(), OpenOption::READONLY};
+            for (int i = 0; i < 3; ++i) {
+                auto total = conn.prepare("SELECT sum(length(b)) FROM t");
+                ASSERT_EQ(2000000, total.execute().fieldT<int>());
+                sample();
+            }
+            for (int i = 0; i < 200; ++i) {
+                auto row = conn.prepareCached("SELECT length(b) FROM t WHERE a = ?");
+                ASSERT_EQ(1000, row.execute(i % 10 + 1).fieldT<int>());
+            }
+            sample();
+        };
+        std::vector<std::thread> threads {};
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back(scan);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        auto const stats = cache.stats();
+        EXPECT_EQ(budget, stats.budget);
+        // sampled with the readers' pages still cached. A page goes over budget only when no
+        // page could be evicted, none being unpinned or every other shard's lock taken
+        constexpr std::size_t pageBytes {2 * 4096};  // generous: sqlite's extra and the header
+        EXPECT_GT(peakBytes, budget / 2);
+        EXPECT_LE(peakBytes, budget + stats.overBudget * pageBytes);
+        EXPECT_GT(stats.evictions, 0);
+        EXPECT_GT(stats.hits, 0);
+        EXPECT_GT(stats.misses, 0);
+        EXPECT_TRUE(cache.caches().empty());  // every connection closed
+
+        Connection conn {dbPath.string(), OpenOption::READONLY};
+        (void)conn.prepare("SELECT count(*) FROM t").execute().fieldT<int>();
+        auto const caches = cache.caches();
+        ASSERT_EQ(1, caches.size());
+        EXPECT_EQ(4096, caches[0].pageSize);
+        EXPECT_TRUE(caches[0].purgeable);
+        EXPECT_GT(caches[0].pages, 0);
+        EXPECT_GE(caches[0].misses, conn.status().cacheMiss);  // every pager miss misses here
+    }
+    EXPECT_EQ(0, cache.stats().bytes);
+}
+
+TEST_F(PageCacheTests, idle_connection_pages_reclaimed_from_another_shard)
+{
+    PageCache cache {budget, 2};
+    PageCacheInit const init {cache};
+    {
+        Connection conn {dbPath.string(), OpenOption::CREATERW};  // first shard, then closed
+        conn.quickQuery("CREATE TABLE t(a INTEGER PRIMARY KEY, b);"
+                        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+                        "WHERE i < 500) INSERT INTO t SELECT i, randomblob(1000) FROM n");
+    }
+    auto scan = [](Connection& conn) {
+        auto total = conn.prepare("SELECT sum(length(b)) FROM t");
+        ASSERT_EQ(500000, total.execute().fieldT<int>());
+    };
+
+    Connection idle {dbPath.string(), OpenOption::READONLY};  // second shard
+    scan(idle);
+    auto const idlePages = cache.caches().at(0).pages;
+    EXPECT_GT(idlePages * 4096, budget / 2);
+
+    Connection busy {dbPath.string(), OpenOption::READONLY};  // first shard, empty
+    scan(busy);
+
+    auto const stats = cache.stats();
+    EXPECT_EQ(0, stats.overBudget);
+    EXPECT_LE(stats.bytes, budget);
+    auto const caches = cache.caches();
+    ASSERT_EQ(2, caches.size());
+    EXPECT_LT(std::min(caches[0].pages, caches[1].pages), idlePages);
+}
+
+TEST_F(PageCacheTests, memory_databases_are_never_evicted)
+{
+    PageCache cache {budget};
+    {
+        PageCacheInit const init {cache};
+
+        Connection conn {":memory:", OpenOption::READWRITE};
+        conn.quickQuery("CREATE TABLE t(a INTEGER PRIMARY KEY, b);"
+                        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+                        "WHERE i < 1000) INSERT INTO t SELECT i, randomblob(1000) FROM n");
+        EXPECT_EQ(1000000, conn.prepare("SELECT sum(length(b)) FROM t").execute().fieldT<int>());
+
+        auto const stats = cache.stats();
+        EXPECT_GT(stats.bytes, budget);
+        EXPECT_GT(stats.overBudget, 0);
+        EXPECT_EQ(0, stats.evictions);
+
+        EXPECT_THROW(PageCacheInit {cache}, std::runtime_error);
+    }
+
+    // sqlite's own cache again
+    Connection conn {":memory:", OpenOption::READWRITE};
+    EXPECT_EQ(3, conn.prepare("SELECT 3").execute().fieldT<int>());
+}
+
+//--------------------------------------------------------------------------------------------------
@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include <atomic>
+#include <thread>
+
+#include <cpp4sqlite_pool.h>
+#include <gtest/gtest.h>
+
+#include "cpp4sqlite_temp_db.h"
+
+using namespace cpp4sqlite;
+
+class PoolTests: public testing::Test
+{
+protected:
+    TempDatabase const dbPath {"cpp4sqlite_pool_test.db"};
+};
+
+//--------------------------------------------------------------------------------------------------
+
+TEST_F(PoolTests, writer_changes_visible_to_readers)
+{
+    ConnectionPool pool {dbPath.string(), 2};
+    {
+        auto writer = pool.writer();
+        writer->quickQuery("CREATE TABLE t(a); INSERT INTO t VALUES (42)");
+    }
+
+    auto reader = pool.reader();
+    EXPECT_EQ(42, reader->prepareCached("SELECT a FROM t").execute().fieldT<int>());
+}
+
+TEST_F(PoolTests, handle_returns_connection_on_destruction)
+{
+    ConnectionPool pool {dbPath.string(), 2};
+    {
+        auto first = pool.reader();
+        auto second = pool.reader();
+        EXPECT_EQ(0, pool.idleReaders());
+    }
+    EXPECT_EQ(2, pool.idleReaders());
+    EXPECT_EQ(2, pool.metrics().checkouts);
+}
+
+TEST_F(PoolTests, exhausted_pool_times_out)
+{
+    ConnectionPool pool {dbPath.string(), 1};
+    auto held = pool.reader();
+
+    EXPECT_THROW((void)pool.reader(std::chrono::milliseconds {10}), std::runtime_error);
+
+    auto const metrics = pool.metrics();
+    EXPECT_EQ(1, metrics.exhausted);
+    EXPECT_EQ(1, metrics.timeouts);
+    EXPECT_GE(metrics.maxWait, std::chrono::milliseconds {10});
+}
+
+TEST_F(PoolTests, waiting_checkout_gets_released_connection)
+{
+    ConnectionPool pool {dbPath.string(), 1};
+    auto held = std::make_unique<ConnectionPool::Handle>(pool.reader());
+
+    std::thread releaser {[&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds {20});
+        held.reset();
+    }};
+    auto handle = pool.reader(std::chrono::milliseconds {2000});
+    releaser.join();
+
+    EXPECT_EQ(1, pool.metrics().exhausted);
+    EXPECT_EQ(0, pool.metrics().timeouts);
+}
+
+TEST_F(PoolTests, writer_waits_out_another_connections_lock)
+{
+    ConnectionPool pool {dbPath.string(), 1};
+    pool.writer()->quickQuery("CREATE TABLE t(a)");
+
+    Connection other {dbPath.string(), OpenOption::READWRITE};
+    other.quickQuery("BEGIN IMMEDIATE");
+    std::thread release {[&other] {
+        std::this_thread::sleep_for(std::chrono::milliseconds {50});
+        other.quickQuery("COMMIT");
+    }};
+
+    EXPECT_NO_THROW(pool.writer()->quickQuery("INSERT INTO t VALUES (1)"));
+    release.join();
+    EXPECT_EQ(1, pool.reader()->prepare("SELECT count(*) FROM t").execute().fieldT<int>());
+}
+
+TEST_F(PoolTests, concurrent_readers)
+{
+    ConnectionPool pool {dbPath.string(), 4};
+    {
+        auto writer = pool.writer();
+        writer->quickQuery("CREATE TABLE t(a); INSERT INTO t VALUES (1), (2), (3)");
+    }
+
+    std::atomic<int> total {0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] {
+            for (int j = 0; j < 50; ++j) {
+                auto reader = pool.reader();
+                auto const sum =
+                    reader->prepareCached("SELECT sum(a) FROM t").execute().fieldT<int>();
+                total += sum.value();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(4 * 50 * 6, total);
+}
@@ -0,0 +1,73 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#include <cpp4sqlite_profile.h>
+#include <gtest/gtest.h>
+
+using namespace cpp4sqlite;
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(ProfileTests, normalise_replaces_literals)
+{
+    EXPECT_EQ("SELECT * FROM t1 WHERE a = ? AND b IN (?, ?) AND c = ?",
+              Profiler::normalise("SELECT *\n  FROM t1 -- note\n WHERE a = 'it''s'"
+                                  " AND b IN (1, 2.5e-3) AND c = x'00ff';"));
+    EXPECT_EQ("SELECT \"col 1\" FROM t WHERE id = ?2 AND n = :name",
+              Profiler::normalise("SELECT \"col 1\" /* c */ FROM t WHERE id = ?2 AND n = :name"));
+}
+
+TEST(ProfileTests, buckets_are_contiguous)
+{
+    for (int bucket = 0; bucket < 400; ++bucket) {
+        auto const bound = LatencyHistogram::upperBound(bucket);
+        EXPECT_EQ(bucket, LatencyHistogram::bucketOf(bound));
+        EXPECT_EQ(bucket + 1, LatencyHistogram::bucketOf(bound + 1));
+    }
+}
+
+TEST(ProfileTests, percentiles_within_bucket_precision)
+{
+    LatencyHistogram histogram {};
+    for (std::uint64_t i = 1; i <= 10000; ++i) {
+        histogram.record(i * 1000);
+    }
+
+    QueryProfile profile {};
+    histogram.snapshot(profile);
+
+    EXPECT_EQ(10000, profile.count);
+    EXPECT_EQ(std::chrono::nanoseconds {10000000}, profile.max);
+    auto const within = [](std::chrono::nanoseconds actual, std::int64_t expect) {
+        return actual.count() >= expect && actual.count() <= expect + expect / 8;
+    };
+    EXPECT_TRUE(within(profile.p50, 5000000)) << profile.p50.count();
+    EXPECT_TRUE(within(profile.p99, 9900000)) << profile.p99.count();
+    EXPECT_TRUE(within(profile.p999, 9990000)) << profile.p999.count();
+}
+
+TEST(ProfileTests, connection_records_per_query_shape)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    EXPECT_TRUE(conn.profile().empty());
+
+    conn.enableProfiling();
+    for (int i = 0; i < 10; ++i) {
+        (void)conn.quickQuery("SELECT " + std::to_string(i));
+    }
+    conn.disableProfiling();
+    (void)conn.quickQuery("SELECT 99");
+
+    auto const profiles = conn.profile();
+    ASSERT_EQ(1, profiles.size());
+    EXPECT_EQ("SELECT ?", profiles[0].sql);
+    EXPECT_EQ(10, profiles[0].count);
+    EXPECT_LE(profiles[0].p50, profiles[0].p999);
+    EXPECT_LE(profiles[0].p999, profiles[0].max);
+
+    conn.resetProfile();
+    EXPECT_EQ(0, conn.profile()[0].count);
+}
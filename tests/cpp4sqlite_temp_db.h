@@ -0,0 +1,56 @@
+/*
+ Copyright (c) 2024 Berniev
+
+ Licence: MIT
+ */
+
+#ifndef SQLITE_CPP_TEMP_DB_H
+#define SQLITE_CPP_TEMP_DB_H
+
+#include <filesystem>
+#include <string>
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Database file in the temp directory, for tests and benchmarks. Its files (database, rollback
+ * journal, WAL and shared memory) are removed on construction and destruction, so connections
+ * to it must be closed first: declare it before them.
+ */
+class TempDatabase
+{
+public:
+    explicit TempDatabase(std::string const& fileName)
+        : path {std::filesystem::temp_directory_path() / fileName}
+    {
+        removeFiles();
+    }
+
+    ~TempDatabase()
+    {
+        removeFiles();
+    }
+
+    TempDatabase() = delete;
+    TempDatabase(TempDatabase&) = delete;
+    TempDatabase(TempDatabase&&) = delete;
+    TempDatabase& operator=(TempDatabase&) = delete;
+    TempDatabase& operator=(TempDatabase&&) = delete;
+
+    [[nodiscard]] std::string string() const
+    {
+        return path.string();
+    }
+
+    void removeFiles() const
+    {
+        for (auto const* suffix : {"", "-journal", "-wal", "-shm"}) {
+            std::filesystem::remove(path.string() + suffix);
+        }
+    }
+
+    std::filesystem::path const path;
+};
+
+//--------------------------------------------------------------------------------------------------
+#endif  // SQLITE_CPP_TEMP_DB_H
@@ -5,12 +5,17 @@
  */
 
 #include <algorithm>
+#include <cstdint>
 #include <filesystem>
 #include <memory>
+#include <sstream>
+#include <thread>
 
 #include <cpp4sqlite.h>
 #include <gtest/gtest.h>
 
+#include "cpp4sqlite_temp_db.h"
+
 using namespace cpp4sqlite;
 
 constexpr auto databasePath {":memory:"};
@@ -81,6 +86,33 @@ TEST_F(SqlTests, field_name)
     EXPECT_EQ(expect, result);
 }
 
+TEST_F(SqlTests, field_name_string_view)
+{
+    std::string_view const name {"text_col_key"};
+    auto const result =
+        connection->prepare("SELECT text_col, text_col_key FROM Test WHERE int_col = ?")
+            .execute(2)
+            .fieldS(name);
+
+    EXPECT_EQ("row21", result);
+}
+
+TEST_F(SqlTests, field_name_duplicate_finds_first)
+{
+    auto const result = connection->prepare("SELECT 1 AS a, 2 AS a").execute().fieldT<int>("a");
+
+    EXPECT_EQ(1, result);
+}
+
+TEST_F(SqlTests, field_name_not_found_throws)
+{
+    auto test = [] {
+        (void)connection->prepare("SELECT 1 AS a").execute().fieldS("b");
+    };
+
+    EXPECT_THROW(test(), std::runtime_error);
+}
+
 TEST_F(SqlTests, nextField)
 {
     auto const result =
@@ -613,6 +645,63 @@ TEST_F(SqlTests, bind_one_float)
     EXPECT_TRUE(actual.empty());
 }
 
+TEST_F(SqlTests, bind_one_long_long)
+{
+    auto const result = connection->prepare("SELECT text_col_key FROM Test WHERE int_col = ?")
+                            .execute(51LL)
+                            .fieldS();
+    EXPECT_EQ("row51", result);
+}
+
+TEST_F(SqlTests, bind_int64_beyond_int_range)
+{
+    std::int64_t const big {std::int64_t {1} << 40};
+
+    auto const result = connection->prepare("SELECT ?").execute(big).fieldT<long long>();
+
+    EXPECT_EQ(big, result);
+}
+
+TEST_F(SqlTests, bind_unsigned_bool_float)
+{
+    auto statement = connection->prepare("SELECT ?, ?, ?");
+    auto resultSet = statement.execute(4000000000U, true, 0.5F);
+
+    EXPECT_EQ(4000000000LL, resultSet.fieldT<long long>());
+    EXPECT_EQ(1, resultSet.nextFieldT<int>());
+    EXPECT_EQ(0.5, resultSet.nextFieldT<double>());
+}
+
+TEST_F(SqlTests, bind_string_view)
+{
+    std::string_view const key {"row41 and more", 5};
+
+    auto const result = connection->prepare("SELECT text_col FROM Test WHERE text_col_key = ?")
+                            .execute(key)
+                            .fieldS();
+    EXPECT_EQ("for", result);
+}
+
+TEST_F(SqlTests, bind_optional)
+{
+    std::optional<int> const four {4};
+    std::optional<int> const none {};
+
+    auto statement = connection->prepare("SELECT ?, ?");
+    auto resultSet = statement.execute(four, none);
+
+    EXPECT_EQ(4, resultSet.fieldT<int>());
+    EXPECT_FALSE(resultSet.nextFieldT<int>().has_value());
+}
+
+TEST_F(SqlTests, bind_rvalue_string)
+{
+    auto const result = connection->prepare("SELECT text_col_key FROM Test WHERE text_col = ?")
+                            .execute(std::string {"two"})
+                            .fieldS();
+    EXPECT_EQ("row21", result);
+}
+
 TEST_F(SqlTests, bind_one_string_empty_row)
 {
     auto const actual = connection->prepare("SELECT text_col_key FROM Test WHERE text_col =?")
@@ -996,6 +1085,44 @@ TEST_F(SqlTests, blob_from_std_string_containing_nulls)
     connection->quickQuery("DELETE FROM Test WHERE int_col = '8888'");
 }
 
+TEST_F(SqlTests, bind_borrowed_text)
+{
+    std::string const key {"row41"};
+
+    auto const result = connection->prepare("SELECT text_col FROM Test WHERE text_col_key = ?")
+                            .execute(BorrowedText {key})
+                            .fieldS();
+
+    EXPECT_EQ("for", result);
+}
+
+TEST_F(SqlTests, bind_borrowed_text_is_not_null_terminated)
+{
+    std::string_view const key {"row41 and more", 5};
+
+    auto const result = connection->prepare("SELECT text_col FROM Test WHERE text_col_key = ?")
+                            .execute(BorrowedText {key})
+                            .fieldS();
+
+    EXPECT_EQ("for", result);
+}
+
+TEST_F(SqlTests, blob_from_borrowed_blob_containing_nulls)
+{
+    std::vector<std::byte> const aa {std::byte {'H'}, std::byte {0}, std::byte {'l'}};
+
+    connection->prepare("INSERT INTO Test VALUES (?, ?, ?, ?, ?)")
+        .execute("row812", "€son", 8888, 8.8, BorrowedBlob {aa});
+
+    auto const result = connection->prepare("SELECT blob_col FROM Test WHERE int_col = ?")
+                            .execute(8888)
+                            .fieldT<std::string>();
+
+    EXPECT_EQ(std::string("H\0l", 3), result);
+
+    connection->quickQuery("DELETE FROM Test WHERE int_col = '8888'");
+}
+
 TEST_F(SqlTests, blob_from_and_to_file)
 {
     std::filesystem::path const filePathSrc {"stuff/Test.jpg"};
@@ -1036,3 +1163,1041 @@ TEST_F(SqlTests, blob_from_and_to_file_replace)
     connection->quickQuery("DELETE FROM Test WHERE int_col = '9999'");
     std::remove(filePathDes.c_str());
 }
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(StatementCacheTests, hit_after_first_use)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(i + 1, conn.prepareCached("SELECT ?").execute(i + 1).fieldT<int>());
+    }
+
+    auto const stats = conn.statementCacheStats();
+    EXPECT_EQ(1, stats.misses);
+    EXPECT_EQ(2, stats.hits);
+    EXPECT_EQ(1, stats.size);
+}
+
+TEST(StatementCacheTests, evicts_least_recently_used)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.setStatementCacheCapacity(2);
+
+    (void)conn.prepareCached("SELECT 1");
+    (void)conn.prepareCached("SELECT 2");
+    (void)conn.prepareCached("SELECT 1");
+    (void)conn.prepareCached("SELECT 3");  // evicts SELECT 2
+    (void)conn.prepareCached("SELECT 1");
+
+    auto const stats = conn.statementCacheStats();
+    EXPECT_EQ(1, stats.evictions);
+    EXPECT_EQ(2, stats.hits);
+    EXPECT_EQ(2, stats.size);
+}
+
+TEST(StatementCacheTests, concurrent_lease_of_same_sql_is_uncached)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+
+    auto first = conn.prepareCached("SELECT ?");
+    auto second = conn.prepareCached("SELECT ?");
+
+    EXPECT_EQ(1, first.execute(1).fieldT<int>());
+    EXPECT_EQ(2, second.execute(2).fieldT<int>());
+    EXPECT_EQ(1, conn.statementCacheStats().size);
+}
+
+TEST(StatementCacheTests, returned_statement_is_reset)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a); INSERT INTO t VALUES (1), (2), (3)");
+
+    {
+        auto stmnt = conn.prepareCached("SELECT a FROM t ORDER BY a");
+        auto resultSet = stmnt.execute();
+        (void)resultSet.rowS();
+        (void)resultSet.rowS();
+    }
+
+    EXPECT_EQ(1, conn.prepareCached("SELECT a FROM t ORDER BY a").execute().fieldT<int>());
+    EXPECT_EQ(1, conn.statementCacheStats().hits);
+}
+
+TEST(StatementCacheTests, survives_schema_change)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a); INSERT INTO t VALUES (1)");
+
+    EXPECT_EQ("1", conn.prepareCached("SELECT * FROM t").execute().fieldS());
+    conn.quickQuery("ALTER TABLE t ADD COLUMN b; UPDATE t SET b = 2");
+
+    auto const row = conn.prepareCached("SELECT * FROM t").execute().rowS();
+    SqlRowS const expect {"1", "2"};
+    EXPECT_EQ(expect, row);
+
+    EXPECT_EQ("2", conn.prepareCached("SELECT * FROM t").execute().fieldS("b"));
+}
+
+TEST(StatementCacheTests, zero_capacity_disables_cache)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.setStatementCacheCapacity(0);
+
+    EXPECT_EQ(7, conn.prepareCached("SELECT 7").execute().fieldT<int>());
+    EXPECT_EQ(0, conn.statementCacheStats().size);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(BlobStreamTests, stream_into_zeroblob_and_back)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE files(data BLOB)");
+
+    std::string payload(100000, '\0');
+    for (std::size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>(i % 251);
+    }
+
+    (void)conn.prepare("INSERT INTO files(data) VALUES (?)").execute(ZeroBlob {payload.size()});
+    auto const rowid = conn.lastInsertId();
+
+    std::istringstream source {payload};
+    auto const written = conn.openBlob("files", "data", rowid, Connection::BlobAccess::write)
+                             .writeFrom(source, 4096);
+    EXPECT_EQ(payload.size(), written);
+
+    std::ostringstream sink;
+    auto const read = conn.openBlob("files", "data", rowid).readTo(sink, 1000);
+    EXPECT_EQ(payload.size(), read);
+    EXPECT_EQ(payload, sink.str());
+}
+
+TEST(BlobStreamTests, stream_file_into_blob)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE files(data BLOB)");
+
+    std::filesystem::path const filePathSrc {"stuff/Test.jpg"};
+    auto const sizeSrc = file_size(filePathSrc);
+
+    (void)conn.prepare("INSERT INTO files(data) VALUES (?)").execute(ZeroBlob {sizeSrc});
+    auto blob = conn.openBlob("files", "data", conn.lastInsertId(), Connection::BlobAccess::write);
+
+    EXPECT_EQ(sizeSrc, blob.size());
+    EXPECT_EQ(sizeSrc, blob.writeFrom(filePathSrc));
+
+    std::ifstream file {filePathSrc, std::ios::binary};
+    std::string const expect {std::istreambuf_iterator<char> {file}, {}};
+    EXPECT_EQ(expect, conn.prepare("SELECT data FROM files").execute().fieldT<std::string>());
+}
+
+TEST(BlobStreamTests, open_missing_row_throws)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE files(data BLOB)");
+
+    EXPECT_THROW((void)conn.openBlob("files", "data", 1), std::runtime_error);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(ExecuteManyTests, tuples_in_one_transaction)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a INTEGER, b TEXT)");
+
+    std::vector<std::tuple<int, std::string>> rows;
+    for (int i = 0; i < 1000; ++i) {
+        rows.emplace_back(i, std::to_string(i));
+    }
+
+    auto const affected = conn.prepare("INSERT INTO t VALUES (?, ?)").executeMany(rows);
+
+    EXPECT_EQ(rows.size(), affected);
+    EXPECT_TRUE(conn.getAutocommit());
+    EXPECT_EQ("499500", conn.prepare("SELECT sum(a) FROM t").execute().fieldS());
+}
+
+TEST(ExecuteManyTests, structs_via_projection_with_commit_interval)
+{
+    struct Item
+    {
+        int id;
+        std::string name;
+    };
+
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a INTEGER, b TEXT)");
+
+    std::vector<Item> const items {{1, "one"}, {2, "two"}, {3, "three"}};
+    auto const affected = conn.executeMany(
+        "INSERT INTO t VALUES (?, ?)",
+        items,
+        [](Item const& item) {
+            return std::tie(item.id, item.name);
+        },
+        2);
+
+    EXPECT_EQ(3, affected);
+    EXPECT_EQ("three", conn.prepare("SELECT b FROM t WHERE a = 3").execute().fieldS());
+}
+
+TEST(ExecuteManyTests, single_param_elements)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a INTEGER)");
+
+    std::vector<int> const values {1, 2, 3, 4};
+    EXPECT_EQ(4, conn.executeMany("INSERT INTO t VALUES (?)", values));
+    EXPECT_EQ(0, conn.executeMany("INSERT INTO t VALUES (?)", std::vector<int> {}));
+}
+
+TEST(ExecuteManyTests, failure_rolls_back_batch)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a INTEGER PRIMARY KEY)");
+
+    std::vector<int> const values {1, 2, 2};
+    EXPECT_THROW((void)conn.executeMany("INSERT INTO t VALUES (?)", values), std::runtime_error);
+
+    EXPECT_TRUE(conn.getAutocommit());
+    EXPECT_EQ("0", conn.prepare("SELECT count(*) FROM t").execute().fieldS());
+}
+
+TEST(ExecuteManyTests, failure_keeps_committed_chunks)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a INTEGER PRIMARY KEY)");
+
+    std::vector<int> const values {1, 2, 3, 4, 5, 5};
+    EXPECT_THROW((void)conn.executeMany("INSERT INTO t VALUES (?)", values, 2), std::runtime_error);
+
+    EXPECT_TRUE(conn.getAutocommit());
+    EXPECT_EQ("4", conn.prepare("SELECT count(*) FROM t").execute().fieldS());
+}
+
+TEST(ExecuteManyTests, wrong_param_count_throws)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a INTEGER, b INTEGER)");
+
+    std::vector<std::pair<int, int>> const rows {{1, 2}};
+    EXPECT_THROW((void)conn.executeMany("INSERT INTO t VALUES (?)", rows), std::runtime_error);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+class TransactionTests: public testing::Test
+{
+protected:
+    Connection conn {":memory:", OpenOption::READWRITE};
+
+    void SetUp() override
+    {
+        conn.quickQuery("CREATE TABLE t(a INTEGER)");
+    }
+
+    std::string count()
+    {
+        return conn.prepare("SELECT count(*) FROM t").execute().fieldS();
+    }
+};
+
+TEST_F(TransactionTests, commit_persists)
+{
+    auto transaction = conn.transaction(TransactionMode::immediate);
+    EXPECT_FALSE(conn.getAutocommit());
+    (void)conn.prepare("INSERT INTO t VALUES (1)").execute();
+    transaction.commit();
+
+    EXPECT_FALSE(transaction.active());
+    EXPECT_TRUE(conn.getAutocommit());
+    EXPECT_EQ("1", count());
+}
+
+TEST_F(TransactionTests, rolled_back_on_unwind)
+{
+    auto test = [this] {
+        auto transaction = conn.transaction(TransactionMode::exclusive);
+        (void)conn.prepare("INSERT INTO t VALUES (1)").execute();
+        throw std::runtime_error("unwind");
+    };
+
+    EXPECT_THROW(test(), std::runtime_error);
+    EXPECT_TRUE(conn.getAutocommit());
+    EXPECT_EQ("0", count());
+}
+
+TEST_F(TransactionTests, begin_and_commit_are_cached)
+{
+    for (int i = 0; i < 3; ++i) {
+        conn.transaction().commit();
+    }
+
+    EXPECT_EQ(4, conn.statementCacheStats().hits);
+}
+
+TEST_F(TransactionTests, nested_savepoint_rolls_back_inner_only)
+{
+    auto outer = conn.savepoint();
+    (void)conn.prepare("INSERT INTO t VALUES (1)").execute();
+    {
+        auto inner = conn.savepoint();
+        (void)conn.prepare("INSERT INTO t VALUES (2)").execute();
+    }
+    EXPECT_EQ("1", count());
+
+    {
+        auto inner = conn.savepoint();
+        (void)conn.prepare("INSERT INTO t VALUES (3)").execute();
+        inner.release();
+    }
+    outer.release();
+
+    EXPECT_TRUE(conn.getAutocommit());
+    EXPECT_EQ("2", count());
+}
+
+TEST_F(TransactionTests, savepoint_inside_transaction)
+{
+    auto transaction = conn.transaction();
+    {
+        auto savepoint = conn.savepoint();
+        (void)conn.prepare("INSERT INTO t VALUES (1)").execute();
+    }
+    (void)conn.prepare("INSERT INTO t VALUES (2)").execute();
+    transaction.commit();
+
+    EXPECT_EQ("1", count());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+TEST_F(SqlTests, rowView_fields_by_position_and_name)
+{
+    auto statement = connection->prepare(
+        "SELECT text_col_key, text_col, int_col, float_col, blob_col FROM Test WHERE int_col = ?");
+    auto resultSet = statement.execute(3);
+
+    auto const view = resultSet.rowView();
+    ASSERT_TRUE(view.has_value());
+    EXPECT_EQ(5, view->size());
+    EXPECT_EQ("row31", (*view)[0].text());
+    EXPECT_EQ("text_col", (*view)["text_col"].name());
+    EXPECT_EQ("€tre", (*view)["text_col"].text());
+    EXPECT_EQ(3, (*view)["int_col"].int64());
+    EXPECT_EQ(3.3, (*view)["float_col"].real());
+    EXPECT_TRUE((*view)["blob_col"].isNull());
+    EXPECT_TRUE((*view)["blob_col"].blob().empty());
+
+    EXPECT_FALSE(resultSet.rowView().has_value());
+}
+
+TEST_F(SqlTests, rowView_loop_visits_each_row)
+{
+    auto statement =
+        connection->prepare("SELECT text_col_key FROM Test WHERE int_col = ? ORDER BY 1");
+    auto resultSet = statement.execute(4);
+
+    std::vector<std::string> keys;
+    while (auto const view = resultSet.rowView()) {
+        keys.emplace_back((*view)[0].text());
+    }
+
+    std::vector<std::string> const expect {"row41", "row42"};
+    EXPECT_EQ(expect, keys);
+}
+
+TEST_F(SqlTests, rowView_then_rowS_advances)
+{
+    auto statement =
+        connection->prepare("SELECT text_col_key FROM Test WHERE int_col = ? ORDER BY 1");
+    auto resultSet = statement.execute(4);
+
+    EXPECT_EQ("row41", (*resultSet.rowView())[0].text());
+    SqlRowS const expect {"row42"};
+    EXPECT_EQ(expect, resultSet.rowS());
+}
+
+TEST_F(SqlTests, rowView_iterate_fields)
+{
+    auto statement = connection->prepare("SELECT 'a' AS x, 'b' AS y");
+    auto resultSet = statement.execute();
+
+    std::string names;
+    std::string values;
+    auto const view = resultSet.rowView();
+    for (auto const field : *view) {
+        names += field.name();
+        values += field.text();
+    }
+
+    EXPECT_EQ("xy", names);
+    EXPECT_EQ("ab", values);
+}
+
+TEST_F(SqlTests, rowView_blob_points_at_bytes)
+{
+    std::string const bytes {"H\0l", 3};
+    auto statement = connection->prepare("SELECT ?");
+    auto resultSet = statement.execute(bytes);
+
+    auto const blob = (*resultSet.rowView())[0].blob();
+    ASSERT_EQ(3, blob.size);
+    EXPECT_EQ(std::byte {'H'}, blob.data[0]);
+    EXPECT_EQ(std::byte {0}, blob.data[1]);
+}
+
+TEST_F(SqlTests, range_for_over_rows)
+{
+    auto statement =
+        connection->prepare("SELECT text_col_key FROM Test WHERE int_col = ? ORDER BY 1");
+    auto resultSet = statement.execute(4);
+
+    std::vector<std::string> keys;
+    for (auto const row : resultSet) {
+        keys.emplace_back(row[0].text());
+    }
+
+    std::vector<std::string> const expect {"row41", "row42"};
+    EXPECT_EQ(expect, keys);
+    EXPECT_TRUE(resultSet.empty());
+}
+
+TEST_F(SqlTests, range_with_algorithm_stops_early)
+{
+    auto statement = connection->prepare("SELECT text_col_key, int_col FROM Test ORDER BY 1");
+    auto resultSet = statement.execute();
+
+    auto const found = std::find_if(resultSet.begin(), resultSet.end(), [](RowView const& row) {
+        return row["int_col"].int64() == 3;
+    });
+
+    ASSERT_NE(resultSet.end(), found);
+    EXPECT_EQ("row31", (*found)[0].text());
+}
+
+TEST_F(SqlTests, as_typed_tuples)
+{
+    auto statement = connection->prepare("SELECT text_col_key, int_col, float_col FROM Test "
+                                         "WHERE text_col_key IN (?, ?) ORDER BY 1");
+    auto resultSet = statement.execute("row21", "row91");
+
+    std::vector<std::tuple<std::string, int, std::optional<double>>> rows;
+    for (auto const& [key, intVal, doubleVal] :
+         resultSet.as<std::string, int, std::optional<double>>()) {
+        rows.emplace_back(key, intVal, doubleVal);
+    }
+
+    ASSERT_EQ(2, rows.size());
+    EXPECT_EQ(std::make_tuple(std::string {"row21"}, 2, std::optional<double> {2.2}), rows[0]);
+    EXPECT_EQ(std::make_tuple(std::string {"row91"}, 0, std::optional<double> {}), rows[1]);
+}
+
+TEST_F(SqlTests, as_wrong_type_count_throws)
+{
+    auto statement = connection->prepare("SELECT text_col_key, int_col FROM Test");
+    auto resultSet = statement.execute();
+
+    EXPECT_THROW((void)resultSet.as<std::string>(), std::runtime_error);
+}
+
+TEST_F(SqlTests, column_type_refreshed_per_row)
+{
+    auto statement = connection->prepare(
+        "SELECT int_col FROM Test WHERE text_col_key IN ('row91', 'row21') ORDER BY int_col");
+    auto resultSet = statement.execute();
+
+    EXPECT_FALSE(std::get<0>(resultSet.rowT<int>().value()).has_value());  // NULL sorts first
+    EXPECT_EQ(2, std::get<0>(resultSet.rowT<int>().value()));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+struct TestRow
+{
+    std::string key;
+    std::string text;
+    int intVal;
+    std::optional<double> doubleVal;
+};
+
+struct NamedTestRow
+{
+    double doubleVal;
+    std::string key;
+};
+
+template<>
+struct cpp4sqlite::RowMapping<NamedTestRow>
+{
+    static auto members(NamedTestRow& row)
+    {
+        return std::tie(row.doubleVal, row.key);
+    }
+
+    static constexpr std::array<std::string_view, 2> columns {"float_col", "text_col_key"};
+};
+
+TEST_F(SqlTests, rowAs_aggregate)
+{
+    auto statement = connection->prepare(
+        "SELECT text_col_key, text_col, int_col, float_col FROM Test WHERE int_col = ?");
+    auto resultSet = statement.execute(2);
+
+    auto const row = resultSet.rowAs<TestRow>();
+    ASSERT_TRUE(row.has_value());
+    EXPECT_EQ("row21", row->key);
+    EXPECT_EQ("two", row->text);
+    EXPECT_EQ(2, row->intVal);
+    EXPECT_EQ(2.2, row->doubleVal);
+
+    EXPECT_FALSE(resultSet.rowAs<TestRow>().has_value());
+}
+
+TEST_F(SqlTests, rowAs_reuses_output)
+{
+    auto statement = connection->prepare(
+        "SELECT text_col_key, text_col, int_col, float_col FROM Test WHERE int_col IS NULL");
+    auto resultSet = statement.execute();
+
+    TestRow row {"previous", "previous", 7, 7.7};
+    ASSERT_TRUE(resultSet.rowAs(row));
+    EXPECT_EQ("row91", row.key);
+    EXPECT_EQ(0, row.intVal);
+    EXPECT_FALSE(row.doubleVal.has_value());
+    EXPECT_FALSE(resultSet.rowAs(row));
+}
+
+TEST_F(SqlTests, rowAs_wrong_column_count_throws)
+{
+    auto statement = connection->prepare("SELECT text_col_key FROM Test");
+    auto resultSet = statement.execute();
+
+    EXPECT_THROW((void)resultSet.rowAs<TestRow>(), std::runtime_error);
+}
+
+TEST_F(SqlTests, rowAs_positions_follow_the_row_type)
+{
+    auto statement = connection->prepare(
+        "SELECT text_col_key, text_col, int_col, float_col FROM Test WHERE int_col = ? ORDER BY 1");
+    for (int run = 0; run < 2; ++run) {
+        auto resultSet = statement.execute(4);
+
+        auto const named = resultSet.rowAs<NamedTestRow>();
+        ASSERT_TRUE(named.has_value());
+        EXPECT_EQ("row41", named->key);
+        EXPECT_EQ(4.4, named->doubleVal);
+
+        auto const row = resultSet.rowAs<TestRow>();
+        ASSERT_TRUE(row.has_value());
+        EXPECT_EQ("row42", row->key);
+        EXPECT_EQ(4, row->intVal);
+    }
+}
+
+TEST_F(SqlTests, rowsAs_range)
+{
+    auto statement = connection->prepare(
+        "SELECT text_col_key, text_col, int_col, float_col FROM Test WHERE int_col = ? ORDER BY 1");
+    auto resultSet = statement.execute(4);
+
+    std::vector<std::string> keys;
+    for (TestRow const& row : resultSet.rowsAs<TestRow>()) {
+        keys.push_back(row.key);
+        EXPECT_EQ(4.4, row.doubleVal);
+    }
+
+    std::vector<std::string> const expect {"row41", "row42"};
+    EXPECT_EQ(expect, keys);
+}
+
+TEST_F(SqlTests, rowsAs_mapping_by_column_name)
+{
+    auto statement = connection->prepare("SELECT * FROM Test WHERE int_col = ?");
+    auto resultSet = statement.execute(3);
+
+    std::vector<std::pair<double, std::string>> rows;
+    for (auto const& row : resultSet.rowsAs<NamedTestRow>()) {
+        rows.emplace_back(row.doubleVal, row.key);
+    }
+
+    ASSERT_EQ(1, rows.size());
+    EXPECT_EQ(3.3, rows[0].first);
+    EXPECT_EQ("row31", rows[0].second);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(ColumnBatchTests, batches_with_validity)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(i INTEGER, r REAL, s TEXT)");
+    std::vector<std::tuple<std::optional<int>, double, std::string>> rows;
+    for (int i = 0; i < 10; ++i) {
+        std::optional<int> const intVal {i == 0 ? std::nullopt : std::optional<int> {i}};
+        rows.emplace_back(intVal, i * 0.5, std::to_string(i));
+    }
+    (void)conn.executeMany("INSERT INTO t VALUES (?, ?, ?)", rows);
+
+    auto statement = conn.prepare("SELECT i, r, s FROM t ORDER BY rowid");
+    auto resultSet = statement.execute();
+
+    ColumnBatch batch;
+    ASSERT_EQ(4, resultSet.fetchColumns(batch, 4));
+    ASSERT_EQ(3, batch.columns.size());
+    EXPECT_EQ(ColumnBuffer::Kind::int64, batch.columns[0].kind);  // inferred from decltype
+    EXPECT_EQ(ColumnBuffer::Kind::real, batch.columns[1].kind);
+    EXPECT_EQ(ColumnBuffer::Kind::text, batch.columns[2].kind);
+    EXPECT_FALSE(batch.columns[0].valid(0));
+    EXPECT_TRUE(batch.columns[0].valid(1));
+    std::vector<std::int64_t> const expectInts {0, 1, 2, 3};
+    EXPECT_EQ(expectInts, batch.columns[0].ints);
+    EXPECT_EQ(1.5, batch.columns[1].reals[3]);
+    EXPECT_EQ("3", batch.columns[2].text(3));
+
+    ASSERT_EQ(4, resultSet.fetchColumns(batch, 4));
+    EXPECT_EQ(4, batch.columns[0].ints[0]);
+    EXPECT_EQ("7", batch.columns[2].text(3));
+
+    ASSERT_EQ(2, resultSet.fetchColumns(batch, 4));
+    EXPECT_EQ(2, batch.rows);
+    EXPECT_EQ("9", batch.columns[2].text(1));
+
+    EXPECT_EQ(0, resultSet.fetchColumns(batch, 4));
+}
+
+TEST(ColumnBatchTests, text_arena_is_contiguous)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    auto statement = conn.prepare("SELECT 'ab' UNION ALL SELECT NULL UNION ALL SELECT 'cde'");
+    auto resultSet = statement.execute();
+
+    auto const batch = resultSet.fetchColumns(100);
+    ASSERT_EQ(3, batch.rows);
+    auto const& column = batch.columns[0];
+    EXPECT_EQ("abcde", column.arena);
+    std::vector<std::uint32_t> const expectOffsets {0, 2, 2, 5};
+    EXPECT_EQ(expectOffsets, column.offsets);
+    EXPECT_FALSE(column.valid(1));
+    EXPECT_EQ("cde", column.text(2));
+}
+
+TEST(ColumnBatchTests, zero_batch_size_throws)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    auto statement = conn.prepare("SELECT 1");
+    auto resultSet = statement.execute();
+
+    ColumnBatch batch;
+    EXPECT_THROW((void)resultSet.fetchColumns(batch, 0), std::runtime_error);
+    EXPECT_EQ(1, resultSet.fetchColumns(batch, 1));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(ExecuteScriptTests, typed_results_per_statement)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+
+    auto const results = conn.executeScript(R"(
+        CREATE TABLE t(i INTEGER, r REAL, s TEXT, b BLOB);
+        INSERT INTO t VALUES (1, 1.5, 'one', x'00ff'), (NULL, NULL, NULL, NULL);
+        -- comment
+        SELECT i, r, s, b FROM t ORDER BY rowid;
+        SELECT count(*) AS n FROM t WHERE 0;
+    )");
+
+    ASSERT_EQ(2, results.size());
+
+    SqlColNames const expectColumns {"i", "r", "s", "b"};
+    EXPECT_EQ(expectColumns, results[0].columns);
+    ASSERT_EQ(2, results[0].rows.size());
+    auto const& row = results[0].rows[0];
+    EXPECT_EQ(SqlValue {sqlite3_int64 {1}}, row[0]);
+    EXPECT_EQ(SqlValue {1.5}, row[1]);
+    EXPECT_EQ(SqlValue {std::string {"one"}}, row[2]);
+    EXPECT_EQ((SqlValue {SqlBlob {std::byte {0}, std::byte {0xff}}}), row[3]);
+    EXPECT_EQ(SqlValue {nullptr}, results[0].rows[1][0]);
+
+    EXPECT_EQ(SqlColNames {"n"}, results[1].columns);
+    EXPECT_EQ(1, results[1].rows.size());
+}
+
+TEST(ExecuteScriptTests, error_throws_after_earlier_statements_ran)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+
+    EXPECT_THROW((void)conn.executeScript("CREATE TABLE t(a); SELECT * FROM missing"),
+                 std::runtime_error);
+    EXPECT_EQ(1, conn.executeScript("SELECT count(*) FROM t")[0].rows.size());
+}
+
+TEST(ExecuteScriptTests, quickQuery_spans_statements)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+
+    SqlTable const actual = conn.quickQuery("SELECT 1 AS a; SELECT NULL AS b, 'x' AS c;");
+    SqlTable const expect {{{"a", "1"}}, {{"b", ""}, {"c", "x"}}};
+
+    EXPECT_EQ(expect, actual);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+class StatementStatsTests: public testing::Test
+{
+protected:
+    Connection conn {":memory:", OpenOption::READWRITE};
+
+    void SetUp() override
+    {
+        conn.quickQuery(R"(
+            CREATE TABLE a(x, y);
+            CREATE TABLE b(x, y);
+            WITH RECURSIVE n(v) AS (SELECT 1 UNION ALL SELECT v + 1 FROM n WHERE v < 100)
+            INSERT INTO a SELECT v, 100 - v FROM n;
+            INSERT INTO b SELECT x, y FROM a;
+        )");
+    }
+};
+
+TEST_F(StatementStatsTests, full_scan_and_sort_counted)
+{
+    auto statement = conn.prepare("SELECT x FROM a ORDER BY y");
+    (void)statement.execute().fetchAll();
+
+    auto const stats = statement.stats();
+    EXPECT_EQ("SELECT x FROM a ORDER BY y", stats.sql);
+    EXPECT_EQ(99, stats.fullscanSteps);
+    EXPECT_EQ(1, stats.sorts);
+    EXPECT_EQ(1, stats.runs);
+    EXPECT_GT(stats.vmSteps, 0);
+    EXPECT_GT(stats.memUsed, 0);
+}
+
+TEST_F(StatementStatsTests, automatic_index_counted)
+{
+    auto statement = conn.prepare("SELECT count(*) FROM a JOIN b ON a.x = b.x");
+    EXPECT_EQ(100, statement.execute().fieldT<int>());
+
+    EXPECT_GT(statement.stats().autoIndexes, 0);
+}
+
+TEST_F(StatementStatsTests, resetStats_zeroes_counters)
+{
+    auto statement = conn.prepare("SELECT x FROM a ORDER BY y");
+    (void)statement.execute().fetchAll();
+    statement.resetStats();
+
+    auto const stats = statement.stats();
+    EXPECT_EQ(0, stats.fullscanSteps);
+    EXPECT_EQ(0, stats.sorts);
+    EXPECT_EQ(0, stats.runs);
+    EXPECT_GT(stats.memUsed, 0);
+}
+
+TEST_F(StatementStatsTests, resetStats_keeps_column_names_current)
+{
+    conn.quickQuery("CREATE TABLE c(a)");
+    auto statement = conn.prepare("SELECT * FROM c");
+    (void)statement.execute();
+
+    conn.quickQuery("ALTER TABLE c ADD COLUMN b");
+    (void)statement.execute();
+    statement.resetStats();
+    conn.quickQuery("ALTER TABLE c ADD COLUMN d");
+
+    EXPECT_EQ((SqlColNames {"a", "b", "d"}), statement.execute().columnNames());
+}
+
+TEST_F(StatementStatsTests, connection_walks_live_statements)
+{
+    std::string const sql {"SELECT y FROM b WHERE x > ?"};
+    for (int i = 0; i < 3; ++i) {
+        (void)conn.prepareCached(sql).execute(50).fetchAll();
+    }
+
+    auto const all = conn.statementStats();
+    auto const found = std::find_if(all.begin(), all.end(), [&](auto const& stats) {
+        return stats.sql == sql;
+    });
+    ASSERT_NE(all.end(), found);
+    EXPECT_EQ(3, found->runs);
+    EXPECT_EQ(3 * 99, found->fullscanSteps);
+
+    conn.resetStatementStats();
+    for (auto const& stats : conn.statementStats()) {
+        EXPECT_EQ(0, stats.runs);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+TEST(StatusTests, process_status_tracks_memory)
+{
+    auto const before = ProcessStatus::snapshot();
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a); INSERT INTO t VALUES (randomblob(100000))");
+
+    auto const after = ProcessStatus::snapshot();
+    EXPECT_GT(after.memoryUsed.current, before.memoryUsed.current);
+    EXPECT_GE(after.memoryUsed.highwater, after.memoryUsed.current);
+    EXPECT_GT(after.mallocCount.current, 0);
+}
+
+TEST(StatusTests, connection_status_reports_cache_and_statements)
+{
+    Connection conn {":memory:", OpenOption::READWRITE};
+    conn.quickQuery("CREATE TABLE t(a); INSERT INTO t VALUES (1)");
+    auto statement = conn.prepare("SELECT a FROM t");
+    (void)statement.execute().fetchAll();
+
+    auto const status = conn.status(true);
+    EXPECT_GT(status.cacheUsed, 0);
+    EXPECT_GT(status.schemaUsed, 0);
+    EXPECT_GT(status.stmtUsed, 0);
+    EXPECT_GT(status.cacheHit, 0);
+
+    EXPECT_EQ(0, conn.status().cacheHit);  // reset by the previous read
+}
+
+TEST(StatusTests, footprint_counts_materialised_strings)
+{
+    SqlTable const small {{{"a", "1"}}};
+    SqlTable const large {{{"a", std::string(1000, 'x')}}};
+
+    EXPECT_GE(footprint(large), footprint(small) + 1000);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+class ConfigTests: public testing::Test
+{
+protected:
+    TempDatabase const dbPath {"cpp4sqlite_config_test.db"};
+
+    static std::string pragma(Connection& conn, std::string const& name)
+    {
+        return conn.prepare("PRAGMA " + name).execute().fieldS();
+    }
+};
+
+TEST_F(ConfigTests, settings_applied_at_open)
+{
+    ConnectionConfig config {};
+    config.pageSize = 8192;
+    config.journalMode = JournalMode::wal;
+    config.synchronous = Synchronous::extra;
+    config.cacheSize = -4096;
+    config.mmapSize = 1024 * 1024;
+    config.tempStore = TempStore::memory;
+    config.busyTimeout = std::chrono::milliseconds {1500};
+    config.lookaside = ConnectionConfig::Lookaside {256, 50};
+    config.walAutocheckpoint = 500;
+    config.foreignKeys = true;
+
+    Connection conn {dbPath.string(), OpenOption::CREATERW, config};
+
+    EXPECT_EQ("8192", pragma(conn, "page_size"));
+    EXPECT_EQ("wal", pragma(conn, "journal_mode"));
+    EXPECT_EQ("3", pragma(conn, "synchronous"));
+    EXPECT_EQ("-4096", pragma(conn, "cache_size"));
+    EXPECT_EQ("2", pragma(conn, "temp_store"));
+    EXPECT_EQ("1500", pragma(conn, "busy_timeout"));
+    EXPECT_EQ("500", pragma(conn, "wal_autocheckpoint"));
+    EXPECT_EQ("1", pragma(conn, "foreign_keys"));
+    if (sqlite3_compileoption_used("MAX_MMAP_SIZE=0") == 0) {
+        EXPECT_EQ("1048576", pragma(conn, "mmap_size"));
+    }
+    if (sqlite3_compileoption_used("OMIT_LOOKASIDE") == 0) {
+        // the same work misses more of 256 byte slots than of the default 1200 byte ones
+        Connection defaults {dbPath.string(), OpenOption::READONLY};
+        (void)conn.status(true);
+        for (Connection* const each : {&conn, &defaults}) {
+            EXPECT_EQ("ok", pragma(*each, "integrity_check"));
+        }
+        auto const status = conn.status();
+        EXPECT_GT(status.lookasideUsed.highwater, 0);
+        EXPECT_GT(status.lookasideMissSize, defaults.status().lookasideMissSize);
+    }
+}
+
+TEST_F(ConfigTests, unset_settings_keep_defaults)
+{
+    Connection conn {dbPath.string(), OpenOption::CREATERW, ConnectionConfig {}};
+
+    EXPECT_EQ("delete", pragma(conn, "journal_mode"));
+    EXPECT_EQ("0", pragma(conn, "busy_timeout"));
+}
+
+TEST_F(ConfigTests, presets)
+{
+    {
+        Connection conn {dbPath.string(), OpenOption::CREATERW, ConnectionConfig::bulkIngest()};
+        EXPECT_EQ("wal", pragma(conn, "journal_mode"));
+        EXPECT_EQ("0", pragma(conn, "synchronous"));
+        EXPECT_EQ("0", pragma(conn, "foreign_keys"));
+        conn.quickQuery("CREATE TABLE parent(id INTEGER PRIMARY KEY);"
+                        "CREATE TABLE child(parent REFERENCES parent(id));"
+                        "INSERT INTO child VALUES (1)");
+    }
+    {
+        Connection conn {dbPath.string(), OpenOption::READWRITE, ConnectionConfig::durable()};
+        EXPECT_EQ("2", pragma(conn, "synchronous"));
+        EXPECT_THROW(conn.quickQuery("INSERT INTO child VALUES (2)"), std::runtime_error);
+    }
+    {
+        Connection conn {dbPath.string(), OpenOption::READONLY, ConnectionConfig::readHeavy()};
+        EXPECT_EQ("1", pragma(conn, "synchronous"));
+        EXPECT_EQ("-65536", pragma(conn, "cache_size"));
+    }
+}
+
+TEST_F(ConfigTests, journal_mode_not_applied_throws)
+{
+    ConnectionConfig config {};
+    config.journalMode = JournalMode::wal;
+    EXPECT_THROW((Connection {":memory:", OpenOption::READWRITE, config}), std::runtime_error);
+
+    config.journalMode = JournalMode::memory;
+    Connection conn {":memory:", OpenOption::READWRITE, config};
+    EXPECT_EQ("memory", pragma(conn, "journal_mode"));
+}
+
+TEST_F(ConfigTests, locked_database_throws)
+{
+    Connection writer {dbPath.string(), OpenOption::CREATERW};
+    writer.quickQuery("CREATE TABLE t(a)");
+    auto transaction = writer.transaction(TransactionMode::exclusive);
+
+    ConnectionConfig config {};
+    config.journalMode = JournalMode::wal;
+    EXPECT_THROW((Connection {dbPath.string(), OpenOption::READWRITE, config}), std::runtime_error);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+class BusyTests: public ConfigTests
+{
+protected:
+    BusyPolicy policy {};
+
+    void SetUp() override
+    {
+        Connection conn {dbPath.string(), OpenOption::CREATERW};
+        conn.quickQuery("PRAGMA journal_mode = WAL; CREATE TABLE t(a); INSERT INTO t VALUES (1)");
+        policy.initialDelay = std::chrono::milliseconds {1};
+        policy.maxDelay = std::chrono::milliseconds {10};
+    }
+
+    /**
+     * Commit transaction from another thread after delay
+     */
+    static std::thread commitLater(Transaction& transaction, std::chrono::milliseconds delay)
+    {
+        return std::thread {[&transaction, delay] {
+            std::this_thread::sleep_for(delay);
+            transaction.commit();
+        }};
+    }
+};
+
+TEST_F(BusyTests, begin_immediate_waits_with_backoff)
+{
+    Connection holder {dbPath.string(), OpenOption::READWRITE};
+    Connection waiter {dbPath.string(), OpenOption::READWRITE};
+    waiter.setBusyPolicy(policy);
+
+    auto held = holder.transaction(TransactionMode::immediate);
+    auto committer = commitLater(held, std::chrono::milliseconds {50});
+    {
+        auto transaction = waiter.transaction(TransactionMode::immediate);
+        waiter.quickQuery("INSERT INTO t VALUES (2)");
+        transaction.commit();
+    }
+    committer.join();
+
+    auto const stats = waiter.busyStats();
+    EXPECT_GT(stats.waits, 0);
+    EXPECT_GE(stats.blocked, std::chrono::milliseconds {20});
+    EXPECT_EQ(0, stats.timeouts);
+}
+
+TEST_F(BusyTests, gives_up_after_timeout)
+{
+    policy.timeout = std::chrono::milliseconds {20};
+    Connection holder {dbPath.string(), OpenOption::READWRITE};
+    ConnectionConfig config {};
+    config.busyPolicy = policy;
+    Connection waiter {dbPath.string(), OpenOption::READWRITE, config};
+
+    auto held = holder.transaction(TransactionMode::immediate);
+    auto const start = std::chrono::steady_clock::now();
+    EXPECT_THROW((void)waiter.transaction(TransactionMode::immediate), std::runtime_error);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds {500});
+    EXPECT_EQ(1, waiter.busyStats().timeouts);
+    EXPECT_EQ(0, waiter.busyStats().retries);  // the handler had the whole timeout
+
+    waiter.clearBusyPolicy();
+    EXPECT_EQ(0, waiter.busyStats().waits);
+}
+
+TEST_F(BusyTests, locked_statement_rerun_outside_transaction)
+{
+    policy.initialDelay = std::chrono::milliseconds {20};
+    policy.maxDelay = std::chrono::milliseconds {20};
+    policy.stepRetries = 10;
+    auto const option = OpenOption::READWRITE | OpenOption::SHAREDCACHE;
+    Connection holder {dbPath.string(), option};
+    Connection waiter {dbPath.string(), option};
+    waiter.setBusyPolicy(policy);
+
+    // shared cache table locks return SQLITE_LOCKED without calling the busy handler
+    auto held = holder.transaction(TransactionMode::immediate);
+    holder.quickQuery("INSERT INTO t VALUES (2)");
+    auto committer = commitLater(held, std::chrono::milliseconds {30});
+    EXPECT_EQ(2, waiter.prepare("SELECT count(*) FROM t").execute().fieldT<int>());
+    committer.join();
+
+    EXPECT_GT(waiter.busyStats().retries, 0);
+}
+
+TEST_F(BusyTests, locked_quick_query_rerun)
+{
+    policy.initialDelay = std::chrono::milliseconds {20};
+    policy.maxDelay = std::chrono::milliseconds {20};
+    policy.stepRetries = 10;
+    auto const option = OpenOption::READWRITE | OpenOption::SHAREDCACHE;
+    Connection holder {dbPath.string(), option};
+    Connection waiter {dbPath.string(), option};
+    waiter.setBusyPolicy(policy);
+
+    auto held = holder.transaction(TransactionMode::immediate);
+    holder.quickQuery("INSERT INTO t VALUES (2)");
+    auto committer = commitLater(held, std::chrono::milliseconds {30});
+    EXPECT_NO_THROW(waiter.quickQuery("INSERT INTO t VALUES (3)"));
+    committer.join();
+
+    EXPECT_GT(waiter.busyStats().retries, 0);
+    EXPECT_EQ(3, waiter.prepare("SELECT count(*) FROM t").execute().fieldT<int>());
+}
+
+TEST_F(BusyTests, no_rerun_within_a_transaction)
+{
+    Connection writer {dbPath.string(), OpenOption::READWRITE};
+    Connection reader {dbPath.string(), OpenOption::READWRITE};
+    reader.setBusyPolicy(policy);
+
+    auto transaction = reader.transaction();
+    EXPECT_EQ(1, reader.prepare("SELECT count(*) FROM t").execute().fieldT<int>());
+    writer.quickQuery("INSERT INTO t VALUES (2)");
+
+    // the snapshot is stale: SQLITE_BUSY_SNAPSHOT, only a rollback helps
+    EXPECT_THROW(reader.quickQuery("INSERT INTO t VALUES (3)"), std::runtime_error);
+    EXPECT_THROW((void)reader.prepare("INSERT INTO t VALUES (3)").execute(), std::runtime_error);
+    EXPECT_EQ(0, reader.busyStats().retries);
+}